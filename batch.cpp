@@ -0,0 +1,240 @@
+/**
+ * Batch driver solving many puzzle instances concurrently on a pool of threads.
+ * Compile and run:
+ * g++ -std=c++17 -pedantic -Wall -DNDEBUG -O3 -pthread -o batch batch.cpp && ./batch instances.txt
+ *
+ * Every line of the instance file is one instance, empty lines and lines starting with # are skipped:
+ *   frogs <count> [bfs|dfs]            frogs on either side of one empty stone that should swap sides
+ *   frogs <start> <finish> [bfs|dfs]   layouts written as printed by frogs, e.g. GG_BB BB_GG
+ *   family <depth|noise1|noise2>       the river crossing with one of the three cost functions of family.cpp
+ * One result line is printed per instance and in the order of the file:
+ *   <line>: <instance> solutions=<count> length=<states of the first trace> passed=<states> time=<ms>
+ */
+
+#include "reachability.hpp" // your header-only library solution
+#include "frogs.hpp" // the frog model
+#include "family.hpp" // the river crossing model
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory_resource>
+
+/** A single line of the instance file */
+struct instance_t {
+    enum {
+        frogs, family, invalid
+    } model = invalid;
+    size_t line{0};
+    std::string text;
+    stones_t start, finish;
+    search_order order = search_order::breadth_first;
+    cost_t (*cost)(const state_t &, const cost_t &) = nullptr;
+    std::string error;
+};
+
+/** Everything a worker thread keeps between instances, so the stores and the arena are allocated once per thread */
+struct worker_t {
+    std::shared_ptr<collapse_store<stones_t>> frogStore = std::make_shared<collapse_store<stones_t>>(split_stones);
+    std::shared_ptr<collapse_store<state_t>> familyStore = std::make_shared<collapse_store<state_t>>(split_state);
+    // Searches allocate from the arena, which starts in the buffer and is released after every instance.
+    // The arena does not synchronize, which is fine as it is never shared between threads.
+    std::vector<std::byte> buffer = std::vector<std::byte>(4 << 20);
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+};
+
+// Read a layout like GG_BB, returns false on unknown characters.
+bool parse_stones(const std::string &text, stones_t &stones) {
+    stones.clear();
+    for (auto c: text) {
+        switch (c) {
+            case 'G':
+                stones.push_back(frog::green);
+                break;
+            case 'B':
+                stones.push_back(frog::brown);
+                break;
+            case '_':
+                stones.push_back(frog::empty);
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+instance_t parse_instance(size_t line, const std::string &text) {
+    instance_t instance;
+    instance.line = line;
+    instance.text = text;
+    std::istringstream is{text};
+    std::vector<std::string> words;
+    for (std::string word; is >> word;) {
+        words.push_back(word);
+    }
+
+    if (words[0] == "frogs") {
+        // The search order is the optional last word
+        if (words.size() > 2 && (words.back() == "bfs" || words.back() == "dfs")) {
+            instance.order = words.back() == "dfs" ? search_order::depth_first : search_order::breadth_first;
+            words.pop_back();
+        }
+        if (words.size() == 2 && words[1].find_first_not_of("0123456789") == std::string::npos) {
+            try {
+                auto count = std::stoul(words[1]);
+                if (count > frogs_max()) {
+                    instance.error = "frog count out of range";
+                } else {
+                    instance.start = frogs_start(count);
+                    instance.finish = frogs_finish(count);
+                    instance.model = instance_t::frogs;
+                }
+            } catch (const std::exception &) { // beyond unsigned long or too many stones to allocate
+                instance.error = "frog count out of range";
+            }
+        } else if (words.size() == 3 && parse_stones(words[1], instance.start) &&
+                   parse_stones(words[2], instance.finish) && instance.start.size() == instance.finish.size()) {
+            instance.model = instance_t::frogs;
+        } else {
+            instance.error = "expected: frogs <count>|<start> <finish> [bfs|dfs]";
+        }
+    } else if (words[0] == "family" && words.size() == 2) {
+        if (words[1] == "depth") {
+            instance.cost = depth_cost;
+        } else if (words[1] == "noise1") {
+            instance.cost = son1_noise_cost;
+        } else if (words[1] == "noise2") {
+            instance.cost = son2_noise_cost;
+        }
+        if (instance.cost != nullptr) {
+            instance.model = instance_t::family;
+        } else {
+            instance.error = "expected: family depth|noise1|noise2";
+        }
+    } else {
+        instance.error = "unknown model";
+    }
+    return instance;
+}
+
+// Formats the result line of a solved instance
+template<class SolutionsT>
+std::string describe(const instance_t &instance, const SolutionsT &solutions, size_t passed,
+                     std::chrono::steady_clock::duration time) {
+    std::ostringstream os;
+    os << instance.line << ": " << instance.text
+       << " solutions=" << solutions.size()
+       << " length=" << (solutions.empty() ? 0 : solutions.front().size())
+       << " passed=" << passed
+       << " time=" << std::chrono::duration<double, std::milli>(time).count();
+    return os.str();
+}
+
+std::string solve(const instance_t &instance, worker_t &worker) {
+    auto begin = std::chrono::steady_clock::now();
+    // The search is done when this returns, so everything it allocated can go in one call.
+    struct release_t {
+        std::pmr::monotonic_buffer_resource &arena;
+
+        ~release_t() { arena.release(); }
+    } release{worker.arena};
+    switch (instance.model) {
+        case instance_t::frogs: {
+            auto space = state_space_t{instance.start, successors<stones_t>(transitions)};
+            space.use_store(worker.frogStore);
+            space.detect_duplicates(duplicate_detection::on_generation);
+            space.use_resource(&worker.arena);
+            auto solutions = space.check(
+                    [&finish = instance.finish](const stones_t &state) { return state == finish; },
+                    instance.order);
+            return describe(instance, solutions, worker.frogStore->size(), std::chrono::steady_clock::now() - begin);
+        }
+        case instance_t::family: {
+            auto space = state_space_t{state_t{}, cost_t{}, successors<state_t>(transitions),
+                                       &river_crossing_valid, instance.cost};
+            space.use_store(worker.familyStore);
+            space.detect_duplicates(duplicate_detection::on_generation);
+            space.use_resource(&worker.arena);
+            auto solutions = space.check(&goal);
+            return describe(instance, solutions, worker.familyStore->size(), std::chrono::steady_clock::now() - begin);
+        }
+        default:
+            return std::to_string(instance.line) + ": " + instance.text + " error=" + instance.error;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <instance file> [threads]\n";
+        return 1;
+    }
+    std::ifstream file{argv[1]};
+    if (!file) {
+        std::cerr << "Could not open " << argv[1] << '\n';
+        return 1;
+    }
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 2) {
+        try {
+            threads = std::stoul(argv[2]);
+        } catch (const std::exception &) {
+            threads = 0;
+        }
+        if (threads == 0) {
+            std::cerr << "Invalid thread count " << argv[2] << '\n';
+            return 1;
+        }
+    }
+
+    std::vector<instance_t> instances;
+    size_t line = 0;
+    for (std::string text; std::getline(file, text);) {
+        ++line;
+        auto first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos || text[first] == '#') {
+            continue;
+        }
+        text = text.substr(first, text.find_last_not_of(" \t\r") + 1 - first);
+        instances.push_back(parse_instance(line, text));
+    }
+
+    // The invariant of the family model explains every rejected state, which is only noise here.
+    log_enabled = false;
+
+    // Results are printed in the order of the file as soon as all earlier instances are done.
+    std::vector<std::string> results(instances.size());
+    std::vector<bool> done(instances.size(), false);
+    size_t printed = 0;
+    std::mutex resultMutex;
+    std::atomic<size_t> next{0};
+
+    auto work = [&]() {
+        worker_t worker;
+        for (auto i = next++; i < instances.size(); i = next++) {
+            auto result = solve(instances[i], worker);
+            std::lock_guard<std::mutex> lock{resultMutex};
+            results[i] = std::move(result);
+            done[i] = true;
+            while (printed < instances.size() && done[printed]) {
+                std::cout << results[printed++] << '\n';
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < std::min<size_t>(threads, instances.size()); ++t) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (auto &thread: pool) {
+        thread.join();
+    }
+    std::cout.flush();
+}
@@ -0,0 +1,52 @@
+/**
+ * Solves the leaping frogs puzzle with the passed states partitioned over several worker processes.
+ * Compile and run with the number of frogs on each side and the number of workers:
+ * g++ -std=c++17 -pedantic -Wall -DNDEBUG -O3 -o distributed distributed.cpp && ./distributed 8 4
+ */
+
+#include "reachability.hpp" // your header-only library solution
+#include "distributed.hpp" // the distributed exploration
+#include "frogs.hpp" // the frog model
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+// Reads a positive count from the command line, 0 if it is not one
+size_t parse_count(const char *text) {
+    try {
+        return std::stoul(text);
+    } catch (const std::exception &) {
+        return 0;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    auto frogs = argc > 1 ? parse_count(argv[1]) : 8;
+    auto workers = argc > 2 ? parse_count(argv[2]) : 4;
+    if (frogs == 0 || frogs > frogs_max() || workers == 0) {
+        std::cerr << "Usage: " << argv[0] << " [frogs on each side] [workers], both at least 1\n";
+        return 1;
+    }
+    auto start = frogs_start(frogs);
+    auto finish = frogs_finish(frogs);
+    auto isFinish = [&finish](const stones_t &state) { return state == finish; };
+    std::cout << "Leaping frog puzzle start: " << start << ", finish: " << finish << '\n';
+
+    auto begin = std::chrono::steady_clock::now();
+    auto solutions = check_distributed(start, successors<stones_t>(transitions), isFinish, workers);
+    auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    for (auto &&trace: solutions)
+        std::cout << workers << " workers: trace of " << trace.size() << " states from " << trace.front()
+                  << " to " << trace.back() << " in " << time << " ms\n";
+
+    // The same search in a single process for comparison
+    begin = std::chrono::steady_clock::now();
+    auto space = state_space_t{start, successors<stones_t>(transitions)};
+    space.use_store(std::make_shared<hash_store<stones_t>>());
+    space.detect_duplicates(duplicate_detection::on_generation);
+    solutions = space.check(isFinish);
+    time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    for (auto &&trace: solutions)
+        std::cout << "1 process: trace of " << trace.size() << " states in " << time << " ms\n";
+}
@@ -0,0 +1,440 @@
+/**
+ * Distributed breadth-first exploration over several worker processes on one Linux machine.
+ * Every worker owns the states with state_hash(state) % workers equal to its number, so the passed states and the
+ * frontier are partitioned and no process has to hold all of them. The workers are connected pairwise by local
+ * sockets and send their successor batches directly to the owners. The calling process becomes the coordinator:
+ * it forks the workers, starts the rounds, detects termination and reconstructs the traces by asking the owners
+ * of the states for their parents.
+ *
+ * The exploration proceeds in rounds, one per breadth-first level:
+ * 1. the coordinator tells every worker to start the round,
+ * 2. each worker drops the states of its inbox it has seen before, checks the goal on the new ones, expands them,
+ *    sends every other worker the successors it owns and receives the successors it owns itself for its next inbox,
+ * 3. each worker answers the coordinator with its goals and the number of successors it generated,
+ * 4. when no successors were generated the exploration has terminated.
+ * States are sent with state_codec, so they must be trivially copyable, contiguous containers of trivially
+ * copyable values or have a state_codec specialization.
+ */
+
+#ifndef PUZZLEENGINE_DISTRIBUTED_HPP
+#define PUZZLEENGINE_DISTRIBUTED_HPP
+
+#include "reachability.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept> // For runtime_error
+#include <cerrno> // For errno
+#include <csignal> // For kill
+#include <tuple> // For tie
+#include <poll.h> // For poll
+#include <sys/socket.h> // For socketpair
+#include <sys/wait.h> // For waitpid
+#include <unistd.h> // For fork and read
+
+// Messages between the coordinator and the workers
+enum class distributed_message : char {
+    expand = 'E', trace = 'T', quit = 'Q'
+};
+
+// Parent reference of a state: the owning worker and the index of the state in it
+struct distributed_ref {
+    uint32_t worker;
+    uint32_t index;
+};
+
+// Reference of the initial state, which has no parent
+constexpr uint32_t no_worker = UINT32_MAX;
+
+// Appends a plain value to a message
+template<class T>
+void put_value(std::string &message, const T &value) {
+    message.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// Reads a plain value from a message and moves past it
+template<class T>
+T take_value(const char *&in) {
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+inline void write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        // No SIGPIPE if the other side is gone, the error is reported instead
+        auto written = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (written <= 0) {
+            throw std::runtime_error("Lost connection to a distributed search process.");
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+inline void read_all(int fd, char *data, size_t size) {
+    while (size > 0) {
+        auto got = ::read(fd, data, size);
+        if (got <= 0) {
+            throw std::runtime_error("Lost connection to a distributed search process.");
+        }
+        data += got;
+        size -= got;
+    }
+}
+
+// Messages are framed as type, payload length and payload
+inline void send_message(int fd, distributed_message type, const std::string &payload) {
+    std::string header;
+    put_value(header, type);
+    put_value(header, static_cast<uint64_t>(payload.size()));
+    write_all(fd, header.data(), header.size());
+    write_all(fd, payload.data(), payload.size());
+}
+
+inline distributed_message receive_message(int fd, std::string &payload) {
+    char header[sizeof(distributed_message) + sizeof(uint64_t)];
+    read_all(fd, header, sizeof(header));
+    const char *in = header;
+    auto type = take_value<distributed_message>(in);
+    payload.resize(take_value<uint64_t>(in));
+    read_all(fd, payload.data(), payload.size());
+    return type;
+}
+
+// The part of the state space owned by one worker process
+template<class StateT, template<class...> class ContainerT, class ValidationF>
+class distributed_worker {
+private:
+    uint32_t _self;
+    std::vector<int> _peers; // worker -> socket to that worker, -1 for self
+    std::function<ContainerT<std::function<void(StateT &)>>(StateT &)> _transitionFunction;
+    std::function<bool(const StateT &)> _invariantFunction;
+    ValidationF _isGoalState;
+    std::unordered_map<StateT, uint32_t, state_hasher> _index; // owned states
+    std::vector<const StateT *> _states; // index -> state, the map nodes do not move
+    std::vector<distributed_ref> _parents; // index -> parent
+    std::string _inbox; // parent references and states generated for this worker in the last round
+
+    // Sends every peer its batch and receives the batch of every peer, both at once so no two workers can block
+    // each other on full sockets. Batches are framed by their length.
+    void exchange(std::vector<std::string> &batches, std::string &inbox) {
+        std::vector<size_t> sent(_peers.size(), 0);
+        std::vector<std::string> received(_peers.size());
+        auto complete = [](const std::string &frame) {
+            if (frame.size() < sizeof(uint64_t)) {
+                return false;
+            }
+            const char *in = frame.data();
+            return frame.size() == sizeof(uint64_t) + take_value<uint64_t>(in);
+        };
+        for (size_t w = 0; w < _peers.size(); ++w) {
+            std::string frame;
+            put_value(frame, static_cast<uint64_t>(batches[w].size()));
+            batches[w].insert(0, frame);
+        }
+
+        std::vector<pollfd> fds;
+        std::vector<size_t> peers;
+        while (true) {
+            fds.clear();
+            peers.clear();
+            for (size_t w = 0; w < _peers.size(); ++w) {
+                if (_peers[w] < 0) {
+                    continue;
+                }
+                short events = 0;
+                if (sent[w] < batches[w].size()) {
+                    events |= POLLOUT;
+                }
+                if (!complete(received[w])) {
+                    events |= POLLIN;
+                }
+                if (events != 0) {
+                    fds.push_back(pollfd{_peers[w], events, 0});
+                    peers.push_back(w);
+                }
+            }
+            if (fds.empty()) {
+                break;
+            }
+            if (::poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Could not wait for the other distributed search workers.");
+            }
+            for (size_t f = 0; f < fds.size(); ++f) {
+                auto w = peers[f];
+                if (fds[f].revents & POLLOUT) {
+                    auto written = ::send(_peers[w], batches[w].data() + sent[w], batches[w].size() - sent[w],
+                                          MSG_NOSIGNAL | MSG_DONTWAIT);
+                    if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                        throw std::runtime_error("Lost connection to a distributed search process.");
+                    }
+                    sent[w] += written > 0 ? written : 0;
+                }
+                if ((fds[f].events & POLLIN) && (fds[f].revents & (POLLIN | POLLHUP | POLLERR))) {
+                    // Read no further than the end of the frame, the next round has not started yet anyway
+                    auto &frame = received[w];
+                    size_t wanted = sizeof(uint64_t) - std::min(frame.size(), sizeof(uint64_t));
+                    if (wanted == 0) {
+                        const char *in = frame.data();
+                        wanted = sizeof(uint64_t) + take_value<uint64_t>(in) - frame.size();
+                    }
+                    char buffer[1 << 16];
+                    auto got = ::recv(_peers[w], buffer, std::min(wanted, sizeof(buffer)), MSG_DONTWAIT);
+                    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                        throw std::runtime_error("Lost connection to a distributed search process.");
+                    }
+                    frame.append(buffer, got > 0 ? got : 0);
+                }
+            }
+        }
+        for (auto &frame: received) {
+            if (!frame.empty()) {
+                inbox.append(frame, sizeof(uint64_t), std::string::npos);
+            }
+        }
+    }
+
+    // Adds the states of the inbox, expands the new ones and exchanges the successors with the other workers.
+    // Answers with the goals and the number of generated successors.
+    std::string expand(const std::string &payload) {
+        _inbox += payload;
+        std::vector<uint32_t> fresh, goals;
+        for (const char *in = _inbox.data(), *end = in + _inbox.size(); in < end;) {
+            auto parent = take_value<distributed_ref>(in);
+            auto state = state_codec<StateT>::decode(in);
+            auto index = static_cast<uint32_t>(_states.size());
+            auto inserted = _index.emplace(std::move(state), index);
+            if (inserted.second) {
+                _states.push_back(&inserted.first->first);
+                _parents.push_back(parent);
+                fresh.push_back(index);
+                if (_isGoalState(inserted.first->first)) {
+                    goals.push_back(index);
+                }
+            }
+        }
+
+        std::vector<std::string> batches(_peers.size());
+        uint64_t generated = 0;
+        for (auto index: fresh) {
+            auto current = *_states[index];
+            for (auto transition: _transitionFunction(current)) {
+                auto successor{current};
+                transition(successor);
+                if (!_invariantFunction(successor)) {
+                    continue;
+                }
+                auto owner = state_hash(successor) % _peers.size();
+                put_value(batches[owner], distributed_ref{_self, index});
+                state_codec<StateT>::encode(successor, batches[owner]);
+                ++generated;
+            }
+        }
+        // The successors owned by this worker stay here, the rest are sent to their owners
+        _inbox.swap(batches[_self]);
+        batches[_self].clear();
+        exchange(batches, _inbox);
+
+        std::string reply;
+        put_value(reply, static_cast<uint64_t>(goals.size()));
+        for (auto goal: goals) {
+            put_value(reply, goal);
+        }
+        put_value(reply, generated);
+        return reply;
+    }
+
+    // Answers with the state and its parent
+    std::string trace(const std::string &payload) {
+        const char *in = payload.data();
+        auto index = take_value<uint32_t>(in);
+        std::string reply;
+        put_value(reply, _parents[index]);
+        state_codec<StateT>::encode(*_states[index], reply);
+        return reply;
+    }
+
+public:
+    distributed_worker(uint32_t self, std::vector<int> peers,
+                       std::function<ContainerT<std::function<void(StateT &)>>(StateT &)> transitionFunction,
+                       std::function<bool(const StateT &)> invariantFunction, ValidationF isGoalState)
+            : _self(self), _peers(std::move(peers)), _transitionFunction(std::move(transitionFunction)),
+              _invariantFunction(std::move(invariantFunction)), _isGoalState(std::move(isGoalState)) {}
+
+    // Serves the coordinator until it says quit
+    void serve(int fd) {
+        std::string payload;
+        while (true) {
+            auto type = receive_message(fd, payload);
+            if (type == distributed_message::expand) {
+                send_message(fd, type, expand(payload));
+            } else if (type == distributed_message::trace) {
+                send_message(fd, type, trace(payload));
+            } else {
+                return;
+            }
+        }
+    }
+};
+
+// Owns the sockets and the worker processes of a distributed search. Unless the search finished, the destructor
+// kills the workers, so none is left blocked on a socket when the coordinator fails, and it always reaps them.
+struct distributed_processes {
+    std::vector<int> sockets; // coordinator ends of the coordinator sockets
+    std::vector<int> workerEnds; // worker ends of the coordinator sockets and the mesh, only needed until the fork
+    std::vector<pid_t> pids;
+    bool finished = false;
+
+    distributed_processes() = default;
+
+    distributed_processes(const distributed_processes &) = delete;
+
+    distributed_processes &operator=(const distributed_processes &) = delete;
+
+    // Creates a connected pair of sockets and returns the ends, both are closed by this
+    std::pair<int, int> connect(bool coordinator) {
+        int pair[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            throw std::runtime_error("Could not create a socket for a distributed search worker.");
+        }
+        (coordinator ? sockets : workerEnds).push_back(pair[0]);
+        workerEnds.push_back(pair[1]);
+        return {pair[0], pair[1]};
+    }
+
+    void closeWorkerEnds() {
+        for (auto fd: workerEnds) {
+            ::close(fd);
+        }
+        workerEnds.clear();
+    }
+
+    ~distributed_processes() {
+        closeWorkerEnds();
+        for (auto fd: sockets) {
+            ::close(fd);
+        }
+        for (auto pid: pids) {
+            if (!finished) {
+                ::kill(pid, SIGKILL);
+            }
+            ::waitpid(pid, nullptr, 0);
+        }
+    }
+};
+
+// Breadth-first search for goal states with the passed states partitioned over the given number of worker
+// processes. Returns one shortest trace per distinct goal state. Forks the calling process, so call it before
+// starting any threads.
+template<class StateT, template<class...> class ContainerT, class ValidationF>
+ContainerT<ContainerT<StateT>> check_distributed(
+        const StateT &initialState,
+        std::function<ContainerT<std::function<void(StateT &)>>(StateT &)> transitionFunction,
+        ValidationF isGoalState,
+        size_t workers,
+        std::function<bool(const StateT &)> invariantFunction = [](const StateT &) { return true; }) {
+    if (workers == 0) {
+        throw std::invalid_argument("A distributed search needs at least one worker.");
+    }
+
+    // Connect every pair of workers and every worker to the coordinator, mesh[a][b] is the socket of a to b
+    distributed_processes processes;
+    auto &sockets = processes.sockets;
+    std::vector<std::vector<int>> mesh(workers, std::vector<int>(workers, -1));
+    std::vector<int> ends; // worker ends of the coordinator sockets
+    for (size_t a = 0; a < workers; ++a) {
+        ends.push_back(processes.connect(true).second);
+        for (size_t b = a + 1; b < workers; ++b) {
+            std::tie(mesh[a][b], mesh[b][a]) = processes.connect(false);
+        }
+    }
+
+    // Start the workers, each keeps only its own sockets
+    for (uint32_t w = 0; w < workers; ++w) {
+        auto pid = ::fork();
+        if (pid < 0) {
+            throw std::runtime_error("Could not fork a distributed search worker.");
+        }
+        if (pid == 0) {
+            // The worker never returns from here, so the processes of the coordinator are not cleaned up twice
+            for (auto fd: sockets) {
+                ::close(fd);
+            }
+            for (auto fd: processes.workerEnds) {
+                if (fd != ends[w] && std::find(mesh[w].begin(), mesh[w].end(), fd) == mesh[w].end()) {
+                    ::close(fd);
+                }
+            }
+            try {
+                distributed_worker<StateT, ContainerT, ValidationF>{w, mesh[w], transitionFunction,
+                                                                    invariantFunction, isGoalState}.serve(ends[w]);
+            } catch (...) {
+                ::_exit(1);
+            }
+            ::_exit(0);
+        }
+        processes.pids.push_back(pid);
+    }
+    processes.closeWorkerEnds();
+
+    // The first round only holds the initial state, sent to its owner
+    std::string first;
+    auto owner = state_hash(initialState) % workers;
+    put_value(first, distributed_ref{no_worker, 0});
+    state_codec<StateT>::encode(initialState, first);
+
+    std::vector<distributed_ref> goals;
+    std::string payload;
+    uint64_t generated = 1;
+    while (generated > 0) {
+        for (size_t w = 0; w < workers; ++w) {
+            send_message(sockets[w], distributed_message::expand, w == owner ? first : std::string{});
+        }
+        first.clear();
+        // Gather the goals and the number of successors the workers exchanged for the next round
+        generated = 0;
+        for (uint32_t w = 0; w < workers; ++w) {
+            receive_message(sockets[w], payload);
+            const char *in = payload.data();
+            auto goalCount = take_value<uint64_t>(in);
+            for (uint64_t g = 0; g < goalCount; ++g) {
+                goals.push_back(distributed_ref{w, take_value<uint32_t>(in)});
+            }
+            generated += take_value<uint64_t>(in);
+        }
+    }
+
+    // Follow the parents of every goal back to the initial state
+    ContainerT<ContainerT<StateT>> result;
+    for (auto goal: goals) {
+        std::vector<StateT> trace;
+        for (auto ref = goal; ref.worker != no_worker;) {
+            std::string request;
+            put_value(request, ref.index);
+            send_message(sockets[ref.worker], distributed_message::trace, request);
+            receive_message(sockets[ref.worker], payload);
+            const char *in = payload.data();
+            ref = take_value<distributed_ref>(in);
+            trace.push_back(state_codec<StateT>::decode(in));
+        }
+        ContainerT<StateT> containedSolution;
+        for (auto state = trace.rbegin(); state != trace.rend(); ++state) {
+            containedSolution.push_back(*state);
+        }
+        result.push_back(containedSolution);
+    }
+
+    for (size_t w = 0; w < workers; ++w) {
+        send_message(sockets[w], distributed_message::quit, {});
+    }
+    processes.finished = true;
+    return result;
+}
+
+#endif //PUZZLEENGINE_DISTRIBUTED_HPP
@@ -13,14 +13,27 @@
  * List:                                                    156532644 ns (108448079 ns)
  * Priority queue instead of sorted list for waiting:       143821806 ns (104294183 ns)
  * With smart pointers:                                     225769872 ns (50065230 ns)
+ * Binary heap / radix queue, median of 5 with --benchmark_min_time=0.5:
+ * Whole search (BM_queue), depth_cost:                     967047 ns / 835951 ns
+ * Whole search (BM_queue), son1_noise_cost:                896436 ns / 1001815 ns
+ * Whole search (BM_queue), son2_noise_cost:                1080026 ns / 880919 ns
+ *   within noise: the invariant and the store dominate, the frontier holds about 100 entries
+ * Queue only (BM_binary_heap/BM_radix_queue), depth, 100:  4227663 ns / 1503897 ns
+ * Queue only, depth, 10000 waiting:                        9531647 ns / 4102644 ns
+ * Queue only, noise, 100 waiting:                          5060388 ns / 1481645 ns
+ * Queue only, noise, 10000 waiting:                        11440229 ns / 4278209 ns
  */
 
+// Enable or disable profiling of the search phases, must be defined before the library is included.
+// #define ENABLE_PROFILING
 #include "reachability.hpp" // your header-only library solution
+#include "family.hpp" // the river crossing model
 
 #include <iostream>
 #include <deque>
 #include <array>
 #include <functional> // std::function
+#include <fstream>
 
 // Enable or disable benchmarking.
 // #define ENABLE_BENCHMARKING
@@ -28,264 +41,13 @@
 #include <benchmark/benchmark.h>
 #endif
 
-/** Model of the river crossing: persons and a boat */
-struct person_t {
-    enum {
-        shore1, onboard, shore2
-    } pos = shore1;
-    enum {
-        mother, father, daughter1, daughter2, son1, son2, policeman, prisoner
-    };
-};
-
-/** Model of a boat */
-struct boat_t {
-    enum {
-        shore1, travel, shore2
-    } pos = shore1;
-    uint16_t capacity{2};
-    uint16_t passengers{0};
-};
-
-/** Model of an entire system */
-struct state_t {
-    boat_t boat;
-    std::array<person_t, 8> persons;
-};
-
-// Compare two people based on their position
-bool operator==(const person_t &p1, const person_t &p2) {
-    return (p1.pos == p2.pos);
-}
-
-// Compare two boats based on their position, passengers and capacity
-bool operator==(const boat_t &b1, const boat_t &b2) {
-    return (b1.pos == b2.pos) &&
-           (b1.passengers == b2.passengers) &&
-           (b1.capacity == b2.capacity);
-}
-
-// Compare if two states are equal using the two previous comparators
-bool operator==(const state_t &state1, const state_t &state2) {
-    return (state1.boat == state2.boat) && (state1.persons == state2.persons);
-}
-
-// Print a persons position
-std::ostream &operator<<(std::ostream &os, const person_t &person) {
-    os << '{';
-    switch (person.pos) {
-        case person_t::shore1:
-            os << "sh1";
-            break;
-        case person_t::shore2:
-            os << "SH2";
-            break;
-        case person_t::onboard:
-            os << "~~~";
-            break;
-    }
-    return os << '}';
-}
-
-// Print a boats position
-std::ostream &operator<<(std::ostream &os, const boat_t &boat) {
-    os << '{';
-    switch (boat.pos) {
-        case boat_t::shore1:
-            os << "sh1";
-            break;
-        case boat_t::travel:
-            os << "trv";
-            break;
-        case boat_t::shore2:
-            os << "SH2";
-            break;
-    }
-    return os << ',' << boat.passengers << ',' << boat.capacity << '}';
-}
-
-// Print the entire state
-std::ostream &operator<<(std::ostream &os, const state_t &state) {
-    return os << state.boat << ','
-              << state.persons[person_t::mother] << ','
-              << state.persons[person_t::father] << ','
-              << state.persons[person_t::daughter1] << ','
-              << state.persons[person_t::daughter2] << ','
-              << state.persons[person_t::son1] << ','
-              << state.persons[person_t::son2] << ','
-              << state.persons[person_t::policeman] << ','
-              << state.persons[person_t::prisoner];
-}
-
-void log(const std::string &input) {
-    std::cout << input << std::endl;
-}
-
-/** Returns a list of transitions applicable on a given state.
- * Transition is a function modifying a state */
-auto transitions(const state_t &s) {
-    auto res = std::deque<std::function<void(state_t &)>>{};
-    switch (s.boat.pos) {
-        case boat_t::shore1:
-        case boat_t::shore2:
-            if (s.boat.passengers > 0) // start traveling
-                res.push_back([](state_t &state) { state.boat.pos = boat_t::travel; });
-            break;
-        case boat_t::travel:
-            res.push_back([](state_t &state) { // arrive to shore1
-                state.boat.pos = boat_t::shore1;
-                state.boat.passengers = 0;
-                for (auto &p: state.persons)
-                    if (p.pos == person_t::onboard)
-                        p.pos = person_t::shore1;
-            });
-            res.push_back([](state_t &state) {    // arrive to shore2
-                state.boat.pos = boat_t::shore2;
-                state.boat.passengers = 0;
-                for (auto &p: state.persons)
-                    if (p.pos == person_t::onboard)
-                        p.pos = person_t::shore2;
-            });
-            break;
-    }
-    for (auto i = 0u; i < s.persons.size(); ++i) {
-        switch (s.persons[i].pos) {
-            case person_t::shore1:  // board the boat on shore1:
-                if (s.boat.pos == boat_t::shore1)
-                    res.push_back([i](state_t &state) {
-                        state.persons[i].pos = person_t::onboard;
-                        ++state.boat.passengers;
-                    });
-                break;
-            case person_t::shore2: // board the boat on shore2:
-                if (s.boat.pos == boat_t::shore2)
-                    res.push_back([i](state_t &state) {
-                        state.persons[i].pos = person_t::onboard;
-                        ++state.boat.passengers;
-                    });
-                break;
-            case person_t::onboard:
-                if (s.boat.pos == boat_t::shore1) // leave the boat to shore1
-                    res.push_back([i](state_t &state) {
-                        state.persons[i].pos = person_t::shore1;
-                        --state.boat.passengers;
-                    });
-                else if (s.boat.pos == boat_t::shore2) // leave the boat to shore2
-                    res.push_back([i](state_t &state) {
-                        state.persons[i].pos = person_t::shore2;
-                        --state.boat.passengers;
-                    });
-                break;
-        }
-    }
-    return res;
-}
-
-bool river_crossing_valid(const state_t &s) {
-    if (s.boat.passengers > s.boat.capacity) {
-        log(" boat overload\n");
-        return false;
-    }
-    if (s.boat.pos == boat_t::travel) {
-        if (s.persons[person_t::daughter1].pos == person_t::onboard) {
-            if (s.boat.passengers == 1 ||
-                (s.persons[person_t::daughter2].pos == person_t::onboard) ||
-                (s.persons[person_t::son1].pos == person_t::onboard) ||
-                (s.persons[person_t::son2].pos == person_t::onboard) ||
-                (s.persons[person_t::prisoner].pos == person_t::onboard)) {
-                log(" d1 travel alone\n");
-                return false;
-            }
-        } else if (s.persons[person_t::daughter2].pos == person_t::onboard) {
-            if (s.boat.passengers == 1 ||
-                (s.persons[person_t::daughter1].pos == person_t::onboard) ||
-                (s.persons[person_t::son1].pos == person_t::onboard) ||
-                (s.persons[person_t::son2].pos == person_t::onboard) ||
-                (s.persons[person_t::prisoner].pos == person_t::onboard)) {
-                log(" d2 travel alone\n");
-                return false;
-            }
-        } else if (s.persons[person_t::son1].pos == person_t::onboard) {
-            if (s.boat.passengers == 1 ||
-                (s.persons[person_t::daughter1].pos == person_t::onboard) ||
-                (s.persons[person_t::daughter2].pos == person_t::onboard) ||
-                (s.persons[person_t::son2].pos == person_t::onboard) ||
-                (s.persons[person_t::prisoner].pos == person_t::onboard)) {
-                log(" s1 travel alone\n");
-                return false;
-            }
-        } else if (s.persons[person_t::son2].pos == person_t::onboard) {
-            if (s.boat.passengers == 1 ||
-                (s.persons[person_t::daughter1].pos == person_t::onboard) ||
-                (s.persons[person_t::daughter2].pos == person_t::onboard) ||
-                (s.persons[person_t::son1].pos == person_t::onboard) ||
-                (s.persons[person_t::prisoner].pos == person_t::onboard)) {
-                log(" s2 travel alone\n");
-                return false;
-            }
-        }
-        if (s.persons[person_t::prisoner].pos != s.persons[person_t::policeman].pos) {
-            auto prisoner_pos = s.persons[person_t::prisoner].pos;
-            if ((s.persons[person_t::daughter1].pos == prisoner_pos) ||
-                (s.persons[person_t::daughter2].pos == prisoner_pos) ||
-                (s.persons[person_t::son1].pos == prisoner_pos) ||
-                (s.persons[person_t::son2].pos == prisoner_pos) ||
-                (s.persons[person_t::mother].pos == prisoner_pos) ||
-                (s.persons[person_t::father].pos == prisoner_pos)) {
-                log(" pr with family\n");
-                return false;
-            }
-        }
-        if (s.persons[person_t::prisoner].pos == person_t::onboard && s.boat.passengers < 2) {
-            log(" pr on boat\n");
-            return false;
-        }
-    }
-    if ((s.persons[person_t::daughter1].pos == s.persons[person_t::father].pos) &&
-        (s.persons[person_t::daughter1].pos != s.persons[person_t::mother].pos)) {
-        log(" d1 with f\n");
-        return false;
-    } else if ((s.persons[person_t::daughter2].pos == s.persons[person_t::father].pos) &&
-               (s.persons[person_t::daughter2].pos != s.persons[person_t::mother].pos)) {
-        log(" d2 with f\n");
-        return false;
-    } else if ((s.persons[person_t::son1].pos == s.persons[person_t::mother].pos) &&
-               (s.persons[person_t::son1].pos != s.persons[person_t::father].pos)) {
-        log(" s1 with m\n");
-        return false;
-    } else if ((s.persons[person_t::son2].pos == s.persons[person_t::mother].pos) &&
-               (s.persons[person_t::son2].pos != s.persons[person_t::father].pos)) {
-        log(" s2 with m\n");
-        return false;
-    }
-    log(" OK\n");
-    return true;
-}
-
-struct cost_t {
-    size_t depth{0}; // counts the number of transitions
-    size_t noise{0}; // kids get bored on shore1 and start making noise there
-    bool operator<(const cost_t &other) const {
-        if (depth > other.depth)
-            return true;
-        if (other.depth > depth)
-            return false;
-        return noise > other.noise;
-    }
-};
-
-// Overload to compare for cost sorting
-bool operator>(const cost_t a, cost_t b) {
-    return a.depth > b.depth;
-}
+#ifdef ENABLE_PROFILING
+// Times every 16th iteration of the searches, written to family.trace.json and family.profile.csv by main
+search_profiler profiler{16};
+#endif
 
 void successors(std::deque<std::function<void(state_t &)>> (*transitions)(const state_t &));
 
-bool goal(const state_t &s) {
-    return std::all_of(std::begin(s.persons), std::end(s.persons),
-                       [](const person_t &p) { return p.pos == person_t::shore2; });
-}
-
 template<typename CostFn>
 void solve(CostFn &&cost) { // no type checking: OK hack here, but not good for library.
     // Overall there are 4*3*2*1/2 solutions to the puzzle
@@ -299,6 +61,11 @@ void solve(CostFn &&cost) { // no type checking: OK hack here, but not good for
             successors<state_t>(transitions), // successor generator from your library
             &river_crossing_valid,            // invariant over states
             std::forward<CostFn>(cost)};      // cost over states
+    // Store passed states collapsed into the boat and the persons
+    states.use_store(std::make_shared<collapse_store<state_t>>(split_state));
+#ifdef ENABLE_PROFILING
+    states.use_profiler(&profiler);
+#endif
     auto solutions = states.check(&goal);
     if (solutions.empty()) {
         std::cout << "No solution\n";
@@ -312,30 +79,57 @@ void solve(CostFn &&cost) { // no type checking: OK hack here, but not good for
     }
 }
 
+// True if the boat travels while the prisoner is with a family member but without the policeman
+bool prisoner_alone_with_family(const state_t &s) {
+    auto &prisoner = s.persons[person_t::prisoner];
+    if (s.boat.pos != boat_t::travel || s.persons[person_t::policeman].pos == prisoner.pos) {
+        return false;
+    }
+    return std::any_of(s.persons.begin(), s.persons.begin() + person_t::policeman,
+                       [&prisoner](const person_t &p) { return p.pos == prisoner.pos; });
+}
+
+// True if both daughters are on shore2
+bool daughters_across(const state_t &s) {
+    return s.persons[person_t::daughter1].pos == person_t::shore2 &&
+           s.persons[person_t::daughter2].pos == person_t::shore2;
+}
+
+void check_questions() {
+    auto states = state_space_t{state_t{}, cost_t{}, successors<state_t>(transitions), &river_crossing_valid,
+                                depth_cost};
+    states.use_store(std::make_shared<collapse_store<state_t>>(split_state));
+    // One exploration answers all the questions, it stops once each has a trace or the states are exhausted
+    log_enabled = false;
+    auto answers = states.check_many({&goal, &prisoner_alone_with_family, &daughters_across});
+    log_enabled = true;
+    const char *questions[] = {"everyone on shore2", "prisoner alone with family", "both daughters on shore2"};
+    auto question = std::begin(questions);
+    for (auto &&traces: answers) {
+        std::cout << *question++ << ": ";
+        if (traces.empty())
+            std::cout << "unreachable\n";
+        else
+            std::cout << "reachable in " << traces.front().size() - 1 << " steps\n";
+    }
+}
+
 #ifndef ENABLE_BENCHMARKING
 int main() {
     std::cout << "-- Solve using depth as a cost: ---\n";
-    solve([](const state_t &state, const cost_t &prev_cost) {
-        return cost_t{prev_cost.depth + 1, prev_cost.noise};
-    }); // it is likely that daughters will get to shore2 first
+    solve(depth_cost); // it is likely that daughters will get to shore2 first
     std::cout << "-- Solve using noise as a cost: ---\n";
-    solve([](const state_t &state, const cost_t &prev_cost) {
-        auto noise = prev_cost.noise;
-        if (state.persons[person_t::son1].pos == person_t::shore1)
-            noise += 2; // older son is more noughty, prefer him first
-        if (state.persons[person_t::son2].pos == person_t::shore1)
-            noise += 1;
-        return cost_t{prev_cost.depth, noise};
-    }); // son1 should get to shore2 first
+    solve(son1_noise_cost); // son1 should get to shore2 first
     std::cout << "-- Solve using different noise as a cost: ---\n";
-    solve([](const state_t &state, const cost_t &prev_cost) {
-        auto noise = prev_cost.noise;
-        if (state.persons[person_t::son1].pos == person_t::shore1)
-            noise += 1;
-        if (state.persons[person_t::son2].pos == person_t::shore1)
-            noise += 2; // younger son is more distressed, prefer him first
-        return cost_t{prev_cost.depth, noise};
-    }); // son2 should get to the shore2 first
+    solve(son2_noise_cost); // son2 should get to the shore2 first
+    std::cout << "-- Check several questions in one search: ---\n";
+    check_questions();
+#ifdef ENABLE_PROFILING
+    std::ofstream trace{"family.trace.json"};
+    profiler.write_chrome_trace(trace);
+    std::ofstream csv{"family.profile.csv"};
+    profiler.write_csv(csv);
+#endif
 }
 #endif
 
@@ -344,30 +138,70 @@ int main() {
 void BM_main(benchmark::State& state){
     for(auto _ : state) {
         std::cout << "-- Solve using depth as a cost: ---\n";
-        solve([](const state_t& state, const cost_t& prev_cost){
-            return cost_t{ prev_cost.depth+1, prev_cost.noise };
-        }); // it is likely that daughters will get to shore2 first
+        solve(depth_cost); // it is likely that daughters will get to shore2 first
         std::cout << "-- Solve using noise as a cost: ---\n";
-        solve([](const state_t& state, const cost_t& prev_cost){
-            auto noise = prev_cost.noise;
-            if (state.persons[person_t::son1].pos == person_t::shore1)
-                noise += 2; // older son is more noughty, prefer him first
-            if (state.persons[person_t::son2].pos == person_t::shore1)
-                noise += 1;
-            return cost_t{ prev_cost.depth, noise };
-        }); // son1 should get to shore2 first
+        solve(son1_noise_cost); // son1 should get to shore2 first
         std::cout << "-- Solve using different noise as a cost: ---\n";
-        solve([](const state_t& state, const cost_t& prev_cost){
-            auto noise = prev_cost.noise;
-            if (state.persons[person_t::son1].pos == person_t::shore1)
-                noise += 1;
-            if (state.persons[person_t::son2].pos == person_t::shore1)
-                noise += 2; // younger son is more distressed, prefer him first
-            return cost_t{ prev_cost.depth, noise };
-        }); // son2 should get to the shore2 first
+        solve(son2_noise_cost); // son2 should get to the shore2 first
     }
 }
 
 BENCHMARK(BM_main)->Iterations(100);
+
+// Searches without printing, the queue is a radix queue if radix is set and a binary heap otherwise
+template<cost_t (*Cost)(const state_t &, const cost_t &)>
+void BM_queue(benchmark::State &state) {
+    log_enabled = false;
+    for (auto _ : state) {
+        auto states = state_space_t{state_t{}, cost_t{}, successors<state_t>(transitions), &river_crossing_valid,
+                                    Cost};
+        states.use_store(std::make_shared<collapse_store<state_t>>(split_state));
+        states.use_radix_queue(state.range(0) != 0);
+        benchmark::DoNotOptimize(states.check(&goal));
+    }
+    log_enabled = true;
+}
+
+BENCHMARK_TEMPLATE(BM_queue, depth_cost)->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_queue, son1_noise_cost)->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_queue, son2_noise_cost)->Arg(0)->Arg(1);
+
+// The waiting queue on its own: keeps range(0) entries waiting and replaces the cheapest by a successor 100000
+// times. The cost grows by one transition as with depth_cost, or by 0-3 noise as with the noise costs.
+template<class QueueT>
+void replay_waiting(QueueT &waiting, size_t frontier, bool noise) {
+    for (size_t i = 0; i < frontier; ++i)
+        waiting.push(cost_entry<state_t, cost_t>{cost_t{}, cost_t{}, nullptr});
+    for (size_t i = 0; i < 100000; ++i) {
+        auto cost = waiting.top().cost;
+        waiting.pop();
+        cost = noise ? cost_t{cost.depth, cost.noise + i % 4} : cost_t{cost.depth + 1, cost.noise};
+        waiting.push(cost_entry<state_t, cost_t>{cost, cost, nullptr});
+    }
+}
+
+template<bool Noise>
+void BM_binary_heap(benchmark::State &state) {
+    for (auto _ : state) {
+        std::priority_queue<cost_entry<state_t, cost_t>> waiting;
+        replay_waiting(waiting, state.range(0), Noise);
+        benchmark::DoNotOptimize(waiting.size());
+    }
+}
+
+template<bool Noise>
+void BM_radix_queue(benchmark::State &state) {
+    auto key = [](const cost_entry<state_t, cost_t> &entry) { return cost_key<cost_t>::key(entry.priority); };
+    for (auto _ : state) {
+        radix_queue<cost_entry<state_t, cost_t>, decltype(key)> waiting{key};
+        replay_waiting(waiting, state.range(0), Noise);
+        benchmark::DoNotOptimize(waiting.size());
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_binary_heap, false)->Arg(100)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_radix_queue, false)->Arg(100)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_binary_heap, true)->Arg(100)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_radix_queue, true)->Arg(100)->Arg(10000);
 BENCHMARK_MAIN();
 #endif
@@ -0,0 +1,324 @@
+/**
+ * Model for Japanese family river crossing puzzle:
+ * https://www.funzug.com/index.php/flash-games/japanese-river-crossing-puzzle-game.html
+ * Author: Marius Mikucionis <marius@cs.aau.dk>
+ * Shared by family.cpp and the batch driver.
+ */
+
+#ifndef PUZZLEENGINE_FAMILY_HPP
+#define PUZZLEENGINE_FAMILY_HPP
+
+#include <iostream>
+#include <string>
+#include <deque>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <functional> // std::function
+
+#include "reachability.hpp"
+
+/** Model of the river crossing: persons and a boat */
+struct person_t {
+    enum {
+        shore1, onboard, shore2
+    } pos = shore1;
+    enum {
+        mother, father, daughter1, daughter2, son1, son2, policeman, prisoner
+    };
+};
+
+/** Model of a boat */
+struct boat_t {
+    enum {
+        shore1, travel, shore2
+    } pos = shore1;
+    uint16_t capacity{2};
+    uint16_t passengers{0};
+};
+
+/** Model of an entire system */
+struct state_t {
+    boat_t boat;
+    std::array<person_t, 8> persons;
+};
+
+// Compare two people based on their position
+inline bool operator==(const person_t &p1, const person_t &p2) {
+    return (p1.pos == p2.pos);
+}
+
+// Compare two boats based on their position, passengers and capacity
+inline bool operator==(const boat_t &b1, const boat_t &b2) {
+    return (b1.pos == b2.pos) &&
+           (b1.passengers == b2.passengers) &&
+           (b1.capacity == b2.capacity);
+}
+
+// Compare if two states are equal using the two previous comparators
+inline bool operator==(const state_t &state1, const state_t &state2) {
+    return (state1.boat == state2.boat) && (state1.persons == state2.persons);
+}
+
+// Print a persons position
+inline std::ostream &operator<<(std::ostream &os, const person_t &person) {
+    os << '{';
+    switch (person.pos) {
+        case person_t::shore1:
+            os << "sh1";
+            break;
+        case person_t::shore2:
+            os << "SH2";
+            break;
+        case person_t::onboard:
+            os << "~~~";
+            break;
+    }
+    return os << '}';
+}
+
+// Print a boats position
+inline std::ostream &operator<<(std::ostream &os, const boat_t &boat) {
+    os << '{';
+    switch (boat.pos) {
+        case boat_t::shore1:
+            os << "sh1";
+            break;
+        case boat_t::travel:
+            os << "trv";
+            break;
+        case boat_t::shore2:
+            os << "SH2";
+            break;
+    }
+    return os << ',' << boat.passengers << ',' << boat.capacity << '}';
+}
+
+// Print the entire state
+inline std::ostream &operator<<(std::ostream &os, const state_t &state) {
+    return os << state.boat << ','
+              << state.persons[person_t::mother] << ','
+              << state.persons[person_t::father] << ','
+              << state.persons[person_t::daughter1] << ','
+              << state.persons[person_t::daughter2] << ','
+              << state.persons[person_t::son1] << ','
+              << state.persons[person_t::son2] << ','
+              << state.persons[person_t::policeman] << ','
+              << state.persons[person_t::prisoner];
+}
+
+// The invariant explains every rejected state, turn this off when solving many instances at once.
+inline bool log_enabled = true;
+
+inline void log(const std::string &input) {
+    if (log_enabled) {
+        std::cout << input << std::endl;
+    }
+}
+
+/** Returns a list of transitions applicable on a given state.
+ * Transition is a function modifying a state */
+inline auto transitions(const state_t &s) {
+    auto res = std::deque<std::function<void(state_t &)>>{};
+    switch (s.boat.pos) {
+        case boat_t::shore1:
+        case boat_t::shore2:
+            if (s.boat.passengers > 0) // start traveling
+                res.push_back([](state_t &state) { state.boat.pos = boat_t::travel; });
+            break;
+        case boat_t::travel:
+            res.push_back([](state_t &state) { // arrive to shore1
+                state.boat.pos = boat_t::shore1;
+                state.boat.passengers = 0;
+                for (auto &p: state.persons)
+                    if (p.pos == person_t::onboard)
+                        p.pos = person_t::shore1;
+            });
+            res.push_back([](state_t &state) {    // arrive to shore2
+                state.boat.pos = boat_t::shore2;
+                state.boat.passengers = 0;
+                for (auto &p: state.persons)
+                    if (p.pos == person_t::onboard)
+                        p.pos = person_t::shore2;
+            });
+            break;
+    }
+    for (auto i = 0u; i < s.persons.size(); ++i) {
+        switch (s.persons[i].pos) {
+            case person_t::shore1:  // board the boat on shore1:
+                if (s.boat.pos == boat_t::shore1)
+                    res.push_back([i](state_t &state) {
+                        state.persons[i].pos = person_t::onboard;
+                        ++state.boat.passengers;
+                    });
+                break;
+            case person_t::shore2: // board the boat on shore2:
+                if (s.boat.pos == boat_t::shore2)
+                    res.push_back([i](state_t &state) {
+                        state.persons[i].pos = person_t::onboard;
+                        ++state.boat.passengers;
+                    });
+                break;
+            case person_t::onboard:
+                if (s.boat.pos == boat_t::shore1) // leave the boat to shore1
+                    res.push_back([i](state_t &state) {
+                        state.persons[i].pos = person_t::shore1;
+                        --state.boat.passengers;
+                    });
+                else if (s.boat.pos == boat_t::shore2) // leave the boat to shore2
+                    res.push_back([i](state_t &state) {
+                        state.persons[i].pos = person_t::shore2;
+                        --state.boat.passengers;
+                    });
+                break;
+        }
+    }
+    return res;
+}
+
+inline bool river_crossing_valid(const state_t &s) {
+    if (s.boat.passengers > s.boat.capacity) {
+        log(" boat overload\n");
+        return false;
+    }
+    if (s.boat.pos == boat_t::travel) {
+        if (s.persons[person_t::daughter1].pos == person_t::onboard) {
+            if (s.boat.passengers == 1 ||
+                (s.persons[person_t::daughter2].pos == person_t::onboard) ||
+                (s.persons[person_t::son1].pos == person_t::onboard) ||
+                (s.persons[person_t::son2].pos == person_t::onboard) ||
+                (s.persons[person_t::prisoner].pos == person_t::onboard)) {
+                log(" d1 travel alone\n");
+                return false;
+            }
+        } else if (s.persons[person_t::daughter2].pos == person_t::onboard) {
+            if (s.boat.passengers == 1 ||
+                (s.persons[person_t::daughter1].pos == person_t::onboard) ||
+                (s.persons[person_t::son1].pos == person_t::onboard) ||
+                (s.persons[person_t::son2].pos == person_t::onboard) ||
+                (s.persons[person_t::prisoner].pos == person_t::onboard)) {
+                log(" d2 travel alone\n");
+                return false;
+            }
+        } else if (s.persons[person_t::son1].pos == person_t::onboard) {
+            if (s.boat.passengers == 1 ||
+                (s.persons[person_t::daughter1].pos == person_t::onboard) ||
+                (s.persons[person_t::daughter2].pos == person_t::onboard) ||
+                (s.persons[person_t::son2].pos == person_t::onboard) ||
+                (s.persons[person_t::prisoner].pos == person_t::onboard)) {
+                log(" s1 travel alone\n");
+                return false;
+            }
+        } else if (s.persons[person_t::son2].pos == person_t::onboard) {
+            if (s.boat.passengers == 1 ||
+                (s.persons[person_t::daughter1].pos == person_t::onboard) ||
+                (s.persons[person_t::daughter2].pos == person_t::onboard) ||
+                (s.persons[person_t::son1].pos == person_t::onboard) ||
+                (s.persons[person_t::prisoner].pos == person_t::onboard)) {
+                log(" s2 travel alone\n");
+                return false;
+            }
+        }
+        if (s.persons[person_t::prisoner].pos != s.persons[person_t::policeman].pos) {
+            auto prisoner_pos = s.persons[person_t::prisoner].pos;
+            if ((s.persons[person_t::daughter1].pos == prisoner_pos) ||
+                (s.persons[person_t::daughter2].pos == prisoner_pos) ||
+                (s.persons[person_t::son1].pos == prisoner_pos) ||
+                (s.persons[person_t::son2].pos == prisoner_pos) ||
+                (s.persons[person_t::mother].pos == prisoner_pos) ||
+                (s.persons[person_t::father].pos == prisoner_pos)) {
+                log(" pr with family\n");
+                return false;
+            }
+        }
+        if (s.persons[person_t::prisoner].pos == person_t::onboard && s.boat.passengers < 2) {
+            log(" pr on boat\n");
+            return false;
+        }
+    }
+    if ((s.persons[person_t::daughter1].pos == s.persons[person_t::father].pos) &&
+        (s.persons[person_t::daughter1].pos != s.persons[person_t::mother].pos)) {
+        log(" d1 with f\n");
+        return false;
+    } else if ((s.persons[person_t::daughter2].pos == s.persons[person_t::father].pos) &&
+               (s.persons[person_t::daughter2].pos != s.persons[person_t::mother].pos)) {
+        log(" d2 with f\n");
+        return false;
+    } else if ((s.persons[person_t::son1].pos == s.persons[person_t::mother].pos) &&
+               (s.persons[person_t::son1].pos != s.persons[person_t::father].pos)) {
+        log(" s1 with m\n");
+        return false;
+    } else if ((s.persons[person_t::son2].pos == s.persons[person_t::mother].pos) &&
+               (s.persons[person_t::son2].pos != s.persons[person_t::father].pos)) {
+        log(" s2 with m\n");
+        return false;
+    }
+    log(" OK\n");
+    return true;
+}
+
+struct cost_t {
+    size_t depth{0}; // counts the number of transitions
+    size_t noise{0}; // kids get bored on shore1 and start making noise there
+    bool operator<(const cost_t &other) const {
+        if (depth > other.depth)
+            return true;
+        if (other.depth > depth)
+            return false;
+        return noise > other.noise;
+    }
+};
+
+// Overload to compare for cost sorting
+inline bool operator>(const cost_t a, cost_t b) {
+    return a.depth > b.depth;
+}
+
+// Costs ordered by depth and then noise, both only grow along a trace, so the cost solver can use a radix queue
+template<>
+struct cost_key<cost_t> {
+    static constexpr bool enabled = true;
+
+    static uint64_t key(const cost_t &cost) {
+        assert(cost.depth <= UINT32_MAX && cost.noise <= UINT32_MAX && "Cost does not fit into the key.");
+        return (static_cast<uint64_t>(cost.depth) << 32) | cost.noise;
+    }
+};
+
+inline bool goal(const state_t &s) {
+    return std::all_of(std::begin(s.persons), std::end(s.persons),
+                       [](const person_t &p) { return p.pos == person_t::shore2; });
+}
+
+// Split a state into the boat and the persons for the collapse store, the same persons recur with many boats.
+inline void split_state(const state_t &state, collapse_store<state_t>::components_t &parts) {
+    parts.push_back(component_of(state.boat));
+    parts.push_back(component_of(state.persons));
+}
+
+// Cost counting the transitions, it is likely that daughters will get to shore2 first
+inline cost_t depth_cost(const state_t &state, const cost_t &prev_cost) {
+    return cost_t{prev_cost.depth + 1, prev_cost.noise};
+}
+
+// Cost where the older son is more noughty, son1 should get to shore2 first
+inline cost_t son1_noise_cost(const state_t &state, const cost_t &prev_cost) {
+    auto noise = prev_cost.noise;
+    if (state.persons[person_t::son1].pos == person_t::shore1)
+        noise += 2;
+    if (state.persons[person_t::son2].pos == person_t::shore1)
+        noise += 1;
+    return cost_t{prev_cost.depth, noise};
+}
+
+// Cost where the younger son is more distressed, son2 should get to shore2 first
+inline cost_t son2_noise_cost(const state_t &state, const cost_t &prev_cost) {
+    auto noise = prev_cost.noise;
+    if (state.persons[person_t::son1].pos == person_t::shore1)
+        noise += 1;
+    if (state.persons[person_t::son2].pos == person_t::shore1)
+        noise += 2;
+    return cost_t{prev_cost.depth, noise};
+}
+
+#endif //PUZZLEENGINE_FAMILY_HPP
@@ -14,6 +14,8 @@
  */
 
 #include "reachability.hpp" // your header-only library solution
+#include "frogs.hpp" // the frog model
+#include "mapped_store.hpp" // passed states in a file
 
 #include <iostream>
 #include <vector>
@@ -26,73 +28,16 @@
 #include <benchmark/benchmark.h>
 #endif
 
-enum class frog {
-    empty, green, brown
-};
-using stones_t = std::vector<frog>;
-
-// Overload to print frog positions
-std::ostream &operator<<(std::ostream &os, const stones_t &stones) {
-    for (auto &&stone: stones)
-        switch (stone) {
-            case frog::green:
-                os << "G";
-                break;
-            case frog::brown:
-                os << "B";
-                break;
-            case frog::empty:
-                os << "_";
-                break;
-        }
-    return os;
-}
-
 // Overload of << operator to print list content
-template<class StateT, template<class...> class ContainerT, typename = std::enable_if_t<!std::is_same<StateT, char>::value>>
-std::ostream &operator<<(std::ostream &os, const ContainerT<ContainerT<StateT>> &v) {
-    for (auto stones : v) {
+template<template<class...> class ContainerT>
+std::ostream &operator<<(std::ostream &os, const ContainerT<stones_t> &v) {
+    for (auto &stones : v) {
         os << "State of " << stones.size() << " stones: " << stones << '\n';
     }
     os << std::endl;
     return os;
 }
 
-auto transitions(const stones_t &stones) {
-    auto res = std::vector<std::function<void(stones_t &)>>{};
-    if (stones.size() < 2)
-        return res;
-    auto i = 0u;
-    while (i < stones.size() && stones[i] != frog::empty) ++i; // find empty stone
-    if (i == stones.size())
-        return res;  // did not find empty stone
-    // explore moves to fill the empty from left to right (only green can do that):
-    if (i > 0 && stones[i - 1] == frog::green)
-        res.push_back([i](stones_t &s) { // green jump to next
-            s[i - 1] = frog::empty;
-            s[i] = frog::green;
-        });
-    if (i > 1 && stones[i - 2] == frog::green)
-        res.push_back([i](stones_t &s) { // green jump over 1
-            s[i - 2] = frog::empty;
-            s[i] = frog::green;
-        });
-    // explore moves to fill the empty from right to left (only brown can do that):
-    if (i < stones.size() - 1 && stones[i + 1] == frog::brown) {
-        res.push_back([i](stones_t &s) { // brown jump to next
-            s[i + 1] = frog::empty;
-            s[i] = frog::brown;
-        });
-    }
-    if (i < stones.size() - 2 && stones[i + 2] == frog::brown) {
-        res.push_back([i](stones_t &s) { // brown jump over 1
-            s[i + 2] = frog::empty;
-            s[i] = frog::brown;
-        });
-    }
-    return res;
-}
-
 void show_successors(const stones_t &state, const size_t level = 0) {
     // Caution: this function uses recursion, which is not suitable for solving puzzles!!
     // 1) some state spaces can be deeper than stack allows.
@@ -131,20 +76,20 @@ void explain() {
 }
 
 void solve(size_t frogs, search_order order = search_order::breadth_first) {
-    const auto stones = frogs * 2 + 1; // frogs on either side and 1 empty in the middle
-    auto start = stones_t(stones, frog::empty);  // initially all empty
-    auto finish = stones_t(stones, frog::empty); // initially all empty
-    while (frogs-- > 0) { // count down from frogs-1 to 0 and put frogs into positions:
-        start[frogs] = frog::green;                  // green on left
-        start[start.size() - frogs - 1] = frog::brown;   // brown on right
-        finish[frogs] = frog::brown;                 // brown on left
-        finish[finish.size() - frogs - 1] = frog::green; // green on right
-    }
+    auto start = frogs_start(frogs);   // green on left, brown on right
+    auto finish = frogs_finish(frogs); // brown on left, green on right
     std::cout << "Leaping frog puzzle start: " << start << ", finish: " << finish << '\n';
     auto space = state_space_t{
             std::move(start),                 // initial state
             successors<stones_t>(transitions) // successor-generating function from your library
     };
+    // Store passed states collapsed into their left and right halves
+    space.use_store(std::make_shared<collapse_store<stones_t>>(split_stones));
+    // Queue every state at most once, breadth first still finds the same shortest trace
+    space.detect_duplicates(duplicate_detection::on_generation);
+    // Allocate the whole search from one buffer, which is released at once when the function returns
+    std::pmr::monotonic_buffer_resource arena;
+    space.use_resource(&arena);
     auto solutions = space.check(
             [finish = std::move(finish)](const stones_t &state) { return state == finish; },
             order);
@@ -154,12 +99,66 @@ void solve(size_t frogs, search_order order = search_order::breadth_first) {
     }
 }
 
+void solve_hashed(size_t frogs) {
+    auto finish = hashed_stones_t{frogs_finish(frogs)};
+    auto space = state_space_t{hashed_stones_t{frogs_start(frogs)}, successors<hashed_stones_t>(hashed_transitions)};
+    // The stones carry their Zobrist hash, so the hash store gets the hash of every successor in O(1)
+    space.use_store(std::make_shared<hash_store<hashed_stones_t>>());
+    auto solutions = space.check([&finish](const hashed_stones_t &state) { return state == finish; });
+    for (auto &&trace: solutions)
+        std::cout << "Solution: trace of " << trace.size() << " states, finish: " << trace.back().stones << '\n';
+}
+
+void solve_mapped(size_t frogs) {
+    auto start = frogs_start(frogs);
+    auto finish = frogs_finish(frogs);
+    auto path = "frogs" + std::to_string(frogs) + ".passed";
+    // Every layout of the same number of stones encodes to the same number of bytes
+    std::string record;
+    state_codec<stones_t>::encode(start, record);
+    {
+        auto space = state_space_t{start, successors<stones_t>(transitions)};
+        // Record the reached states in the file, the file keeps the states of earlier runs too
+        space.record_states(std::make_shared<mapped_store<stones_t>>(path, 1 << 12, record.size()));
+        auto solutions = space.check([&finish](const stones_t &state) { return state == finish; });
+        std::cout << "Found " << solutions.size() << " solutions, reached states recorded in " << path << '\n';
+    }
+    // A later run can look the states up without exploring again
+    auto passed = mapped_store<stones_t>{path};
+    std::cout << "Reopened " << path << " with " << passed.size() << " states, finish "
+              << (passed.contains(finish) ? "is" : "is not") << " reachable\n";
+}
+
+void solve_async(size_t frogs, size_t cancelAfter) {
+    auto finish = frogs_finish(frogs);
+    auto space = state_space_t{frogs_start(frogs), successors<stones_t>(transitions)};
+    auto control = search_control{};
+    control.progressEvery = 100;
+    // Called on the search thread, cancels the search once enough states have been expanded
+    control.progress = [token = control.token, cancelAfter](const search_progress &progress) mutable {
+        std::cout << "Expanded " << progress.expanded << " states, " << progress.frontier << " waiting, depth "
+                  << progress.depth << '\n';
+        if (progress.expanded >= cancelAfter)
+            token.cancel();
+    };
+    auto future = space.check_async([&finish](const stones_t &state) { return state == finish; },
+                                    search_order::breadth_first, control);
+    auto solutions = future.get();
+    std::cout << (control.token.cancelled() ? "Cancelled" : "Done") << " with " << solutions.size() << " solutions\n";
+}
+
 #ifndef ENABLE_BENCHMARKING
 int main() {
     explain();
     std::cout << "--- Solve with depth-first search: ---\n";
     solve(2, search_order::depth_first);
     solve(4); // 20 frogs may take >5.8GB of memory
+    std::cout << "--- Solve with incrementally hashed stones: ---\n";
+    solve_hashed(7);
+    std::cout << "--- Solve and record the reached states in a memory-mapped file: ---\n";
+    solve_mapped(4);
+    std::cout << "--- Solve asynchronously and cancel after 300 states: ---\n";
+    solve_async(5, 300);
 }
 #endif
 
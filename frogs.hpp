@@ -0,0 +1,172 @@
+/**
+ * Model for leaping frogs puzzle:
+ * https://primefactorisation.com/frogpuzzle/
+ * Author: Marius Mikucionis <marius@cs.aau.dk>
+ * Shared by frogs.cpp and the batch driver.
+ */
+
+#ifndef PUZZLEENGINE_FROGS_HPP
+#define PUZZLEENGINE_FROGS_HPP
+
+#include <iostream>
+#include <vector>
+#include <memory_resource>
+#include <functional> // std::function
+#include <stdexcept> // std::length_error
+
+#include "reachability.hpp"
+
+enum class frog {
+    empty, green, brown
+};
+using stones_t = std::pmr::vector<frog>; // pmr, so the states can live in the memory resource of the search
+
+// Overload to print frog positions
+inline std::ostream &operator<<(std::ostream &os, const stones_t &stones) {
+    for (auto &&stone: stones)
+        switch (stone) {
+            case frog::green:
+                os << "G";
+                break;
+            case frog::brown:
+                os << "B";
+                break;
+            case frog::empty:
+                os << "_";
+                break;
+        }
+    return os;
+}
+
+inline auto transitions(const stones_t &stones) {
+    auto res = std::vector<std::function<void(stones_t &)>>{};
+    if (stones.size() < 2)
+        return res;
+    auto i = 0u;
+    while (i < stones.size() && stones[i] != frog::empty) ++i; // find empty stone
+    if (i == stones.size())
+        return res;  // did not find empty stone
+    // explore moves to fill the empty from left to right (only green can do that):
+    if (i > 0 && stones[i - 1] == frog::green)
+        res.push_back([i](stones_t &s) { // green jump to next
+            s[i - 1] = frog::empty;
+            s[i] = frog::green;
+        });
+    if (i > 1 && stones[i - 2] == frog::green)
+        res.push_back([i](stones_t &s) { // green jump over 1
+            s[i - 2] = frog::empty;
+            s[i] = frog::green;
+        });
+    // explore moves to fill the empty from right to left (only brown can do that):
+    if (i < stones.size() - 1 && stones[i + 1] == frog::brown) {
+        res.push_back([i](stones_t &s) { // brown jump to next
+            s[i + 1] = frog::empty;
+            s[i] = frog::brown;
+        });
+    }
+    if (i < stones.size() - 2 && stones[i + 2] == frog::brown) {
+        res.push_back([i](stones_t &s) { // brown jump over 1
+            s[i + 2] = frog::empty;
+            s[i] = frog::brown;
+        });
+    }
+    return res;
+}
+
+// The largest number of frogs on each side that fits into stones_t, 2 * frogs + 1 must not overflow either
+inline size_t frogs_max() {
+    return (stones_t{}.max_size() - 1) / 2;
+}
+
+// The number of stones for the frogs on either side of one empty stone
+inline size_t frogs_stones(size_t frogs) {
+    if (frogs > frogs_max())
+        throw std::length_error("Too many frogs for the stones.");
+    return frogs * 2 + 1;
+}
+
+// Start with the frogs on either side of a single empty stone, green on the left and brown on the right.
+inline stones_t frogs_start(size_t frogs) {
+    auto start = stones_t(frogs_stones(frogs), frog::empty);
+    while (frogs-- > 0) {
+        start[frogs] = frog::green;
+        start[start.size() - frogs - 1] = frog::brown;
+    }
+    return start;
+}
+
+// Finish with the frogs swapped, brown on the left and green on the right.
+inline stones_t frogs_finish(size_t frogs) {
+    auto finish = stones_t(frogs_stones(frogs), frog::empty);
+    while (frogs-- > 0) {
+        finish[frogs] = frog::brown;
+        finish[finish.size() - frogs - 1] = frog::green;
+    }
+    return finish;
+}
+
+// Split the stones into their left and right halves for the collapse store, the halves are shared by many states.
+inline void split_stones(const stones_t &stones, collapse_store<stones_t>::components_t &parts) {
+    auto middle = stones.data() + stones.size() / 2;
+    parts.push_back(component_of(stones.data(), middle));
+    parts.push_back(component_of(middle, stones.data() + stones.size()));
+}
+
+// Zobrist keys for up to 64 stones with the three frog values, more stones are rejected by hashed_stones_t
+inline const zobrist_keys &frog_keys() {
+    static const zobrist_keys keys{64, 3};
+    return keys;
+}
+
+/** Stones carrying their Zobrist hash, kept up to date by set, so the engine hashes a successor in O(1) */
+struct hashed_stones_t {
+    stones_t stones;
+    uint64_t zobrist{0};
+
+    hashed_stones_t() = default;
+
+    explicit hashed_stones_t(stones_t initial) : stones(std::move(initial)) {
+        if (stones.size() > frog_keys().fields())
+            throw std::length_error("Too many stones for the Zobrist keys of the frogs.");
+        for (size_t i = 0; i < stones.size(); ++i)
+            zobrist ^= frog_keys()(i, static_cast<size_t>(stones[i]));
+    }
+
+    size_t hash() const { return zobrist; }
+
+    void set(size_t i, frog value) {
+        zobrist ^= frog_keys().update(i, static_cast<size_t>(stones[i]), static_cast<size_t>(value));
+        stones[i] = value;
+    }
+
+    bool operator==(const hashed_stones_t &other) const { return stones == other.stones; }
+};
+
+// The frog moves on hashed stones, every move puts a frog onto the empty stone and updates the hash.
+inline auto hashed_transitions(const hashed_stones_t &state) {
+    auto res = std::vector<std::function<void(hashed_stones_t &)>>{};
+    const auto &stones = state.stones;
+    if (stones.size() < 2)
+        return res;
+    auto i = 0u;
+    while (i < stones.size() && stones[i] != frog::empty) ++i; // find empty stone
+    if (i == stones.size())
+        return res;  // did not find empty stone
+    auto jump = [i](size_t from) {
+        return [from, i](hashed_stones_t &s) {
+            s.set(i, s.stones[from]);
+            s.set(from, frog::empty);
+        };
+    };
+    if (i > 0 && stones[i - 1] == frog::green)
+        res.push_back(jump(i - 1)); // green jump to next
+    if (i > 1 && stones[i - 2] == frog::green)
+        res.push_back(jump(i - 2)); // green jump over 1
+    if (i < stones.size() - 1 && stones[i + 1] == frog::brown)
+        res.push_back(jump(i + 1)); // brown jump to next
+    if (i < stones.size() - 2 && stones[i + 2] == frog::brown)
+        res.push_back(jump(i + 2)); // brown jump over 1
+    return res;
+}
+
+#endif //PUZZLEENGINE_FROGS_HPP
@@ -0,0 +1,175 @@
+/**
+ * Solves the leaping frogs puzzle with A* guided by an additive pattern database heuristic.
+ * Compile and run with the number of frogs on each side:
+ * g++ -std=c++17 -pedantic -Wall -DNDEBUG -O3 -o frogs_pdb frogs_pdb.cpp && ./frogs_pdb 10
+ * The database is built into frogs<count>.pdb on the first run and memory-mapped by later runs. It has one entry
+ * per placement of the brown frogs, C(2 * count + 1, count) entries, and building it must fit into build_budget.
+ */
+
+#include "reachability.hpp" // your header-only library solution
+#include "pattern_database.hpp" // pattern database heuristics
+#include "frogs.hpp" // the frog model
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <cstdlib> // std::strtoul
+
+/** Number of transitions as a cost, the order is reversed to get the cheapest first from the queue */
+struct depth_t {
+    size_t depth{0};
+
+    bool operator<(const depth_t &other) const { return depth > other.depth; }
+};
+
+// The abstraction keeps only the positions of the brown frogs, green frogs and the empty stone look the same
+uint64_t brown_pattern(const stones_t &stones) {
+    uint64_t pattern = 0;
+    for (size_t i = 0; i < stones.size(); ++i)
+        if (stones[i] == frog::brown)
+            pattern |= uint64_t{1} << i;
+    return pattern;
+}
+
+// Green frogs moving right look like brown frogs moving left in a mirror, so the same database covers them
+uint64_t green_pattern(const stones_t &stones) {
+    uint64_t pattern = 0;
+    for (size_t i = 0; i < stones.size(); ++i)
+        if (stones[i] == frog::green)
+            pattern |= uint64_t{1} << (stones.size() - 1 - i);
+    return pattern;
+}
+
+// Abstract moves: a brown frog moves one or two stones to the left onto a stone without a brown frog. This covers
+// every brown move, as the empty stone is somewhere among the stones without brown frogs.
+auto brown_moves(size_t stones) {
+    return [stones](uint64_t &pattern) {
+        auto res = std::vector<std::function<void(uint64_t &)>>{};
+        for (size_t i = 1; i < stones; ++i) {
+            if ((pattern >> i & 1) == 0)
+                continue;
+            for (size_t to = i - 1, jumps = 0; jumps < 2 && to < stones; --to, ++jumps)
+                if ((pattern >> to & 1) == 0)
+                    res.push_back([i, to](uint64_t &p) { p = (p & ~(uint64_t{1} << i)) | uint64_t{1} << to; });
+        }
+        return res;
+    };
+}
+
+// Numbers the bitmasks with the given number of bits set among the stones 0..size()-1 in colexicographic order, so
+// the database only has entries for patterns that can occur: a pattern always has one bit per frog of a color.
+class subset_rank {
+private:
+    size_t _stones, _bits;
+    std::vector<std::vector<uint64_t>> _binomial; // _binomial[m][k] is m choose k
+
+public:
+    subset_rank(size_t stones, size_t bits)
+            : _stones(stones), _bits(bits), _binomial(stones + 1, std::vector<uint64_t>(bits + 1, 0)) {
+        for (size_t m = 0; m <= stones; ++m) {
+            _binomial[m][0] = 1;
+            for (size_t k = 1; k <= bits && k <= m; ++k)
+                _binomial[m][k] = _binomial[m - 1][k - 1] + _binomial[m - 1][k];
+        }
+    }
+
+    size_t size() const { return _binomial[_stones][_bits]; }
+
+    // The sum of (position choose k) over the k-th set bit from the right
+    size_t operator()(uint64_t pattern) const {
+        size_t rank = 0;
+        for (size_t i = 0, k = 0; i < _stones; ++i)
+            if (pattern >> i & 1)
+                rank += _binomial[i][++k];
+        return rank;
+    }
+
+    uint64_t unrank(size_t rank) const {
+        uint64_t pattern = 0;
+        auto m = _stones;
+        for (auto k = _bits; k > 0; --k) {
+            do --m; while (_binomial[m][k] > rank); // the highest position with m choose k at most the rank
+            rank -= _binomial[m][k];
+            pattern |= uint64_t{1} << m;
+        }
+        return pattern;
+    }
+};
+
+// Memory build_pattern_database may use, the count of frogs is limited by it
+constexpr size_t build_budget = size_t{1} << 30;
+
+// Bytes build_pattern_database needs for the given number of frogs on each side: two 8 byte offsets and a distance
+// per abstract state and a 4 byte predecessor per abstract move, every brown frog has at most two moves.
+// Returns SIZE_MAX if it does not even fit into size_t.
+size_t build_bytes(size_t frogs) {
+    auto states = subset_rank{frogs * 2 + 1, frogs}.size();
+    auto perState = 8 + 8 + 1 + 2 * frogs * 4;
+    return states > SIZE_MAX / perState ? SIZE_MAX : states * perState;
+}
+
+size_t expanded(state_space_t<stones_t, std::vector, depth_t> &space, const stones_t &finish) {
+    size_t count = 0;
+    auto control = search_control{};
+    control.progressEvery = 1;
+    control.progress = [&count](const search_progress &progress) { count = progress.expanded; };
+    auto solutions = space.check([&finish](const stones_t &state) { return state == finish; },
+                                 search_order::breadth_first, &control);
+    std::cout << "trace of " << (solutions.empty() ? 0 : solutions.front().size()) << " states, ";
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    auto frogs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10;
+    // The patterns are 64 bit masks of the stones, and the build has to fit into the budget
+    size_t maxFrogs = 1;
+    while (maxFrogs < 31 && build_bytes(maxFrogs + 1) <= build_budget)
+        ++maxFrogs;
+    if (frogs == 0 || frogs > maxFrogs) {
+        std::cerr << "The number of frogs on each side must be between 1 and " << maxFrogs << ", building the "
+                  << "pattern database must fit into " << (build_budget >> 20) << " MB.\n";
+        return 1;
+    }
+    auto start = frogs_start(frogs);
+    auto finish = frogs_finish(frogs);
+    auto stones = start.size();
+    auto path = "frogs" + std::to_string(frogs) + ".pdb";
+    auto rank = subset_rank{stones, frogs};
+
+    // Build the database unless a database with the expected number of entries exists
+    auto built = false;
+    try {
+        built = pattern_database{path}.size() == rank.size();
+    } catch (const std::runtime_error &) {}
+    if (!built) {
+        auto begin = std::chrono::steady_clock::now();
+        auto goal = (uint64_t{1} << frogs) - 1; // brown frogs on the left
+        build_pattern_database<uint64_t>(
+                path, rank.size(),
+                [&rank](size_t r) { return rank.unrank(r); },
+                [&rank](const uint64_t &pattern) { return rank(pattern); },
+                std::function<std::vector<std::function<void(uint64_t &)>>(uint64_t &)>{brown_moves(stones)},
+                [goal](const uint64_t &pattern) { return pattern == goal; });
+        std::cout << "Built " << path << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count()
+                  << " ms\n";
+    }
+    auto database = pattern_database{path};
+
+    auto space = state_space_t{start, depth_t{}, successors<stones_t>(transitions),
+                               +[](const stones_t &) { return true; }, // no invariant
+                               [](const stones_t &, const depth_t &cost) { return depth_t{cost.depth + 1}; }};
+    space.use_store(std::make_shared<hash_store<stones_t>>());
+    space.limit_solutions(1);
+    std::cout << "Leaping frog puzzle start: " << start << ", finish: " << finish << '\n';
+    std::cout << "Cheapest first: ";
+    std::cout << expanded(space, finish) << " states expanded\n";
+
+    // Each move moves one frog, so the brown and the green distances add up to an admissible estimate
+    space.use_heuristic([&database, &rank](const stones_t &state, const depth_t &cost) {
+        return depth_t{cost.depth + database[rank(brown_pattern(state))] + database[rank(green_pattern(state))]};
+    });
+    std::cout << "A* with pattern database: ";
+    std::cout << expanded(space, finish) << " states expanded\n";
+}
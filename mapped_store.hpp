@@ -0,0 +1,255 @@
+/**
+ * Passed states kept in a memory-mapped file, so they outlive the process and the page cache rather than the heap
+ * holds them. The file is an open addressing hash table of packed states with a fixed capacity: every slot holds a
+ * tag, a fingerprint of the hash and the state encoded with state_codec and padded to a fixed record size.
+ *
+ * As the store of a search it is cleared at the start of every check like any other store. To collect the states
+ * reached across runs or processes pass it to record_states instead: every check still explores on its own and
+ * finds all its traces, while the file accumulates the reached states. Several processes can record into the same
+ * file concurrently, slots are claimed with atomic compare-and-swap on the shared mapping, so each state is stored
+ * once. A writer that dies while writing a slot leaves it unusable, lookups wait stale_after once per process and
+ * then probe past it. A file opened read-only serves lookups with contains only, it can not be inserted into or
+ * cleared, so it can not be given to a state space.
+ */
+
+#ifndef PUZZLEENGINE_MAPPED_STORE_HPP
+#define PUZZLEENGINE_MAPPED_STORE_HPP
+
+#include "reachability.hpp"
+
+#include <string>
+#include <atomic>
+#include <thread> // For yield
+#include <chrono> // For the stale slot timeout
+#include <unordered_set> // For the stale slots
+#include <stdexcept> // For runtime_error
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h> // For fstat
+#include <sys/file.h> // For flock
+#include <fcntl.h> // For open
+#include <unistd.h> // For ftruncate and close
+
+// Identifies mapped store files and their layout version
+constexpr char mapped_store_magic[8] = {'V', 'I', 'S', 'v', '1', 0, 0, 0};
+
+struct mapped_store_header {
+    char magic[8];
+    uint64_t recordSize; // bytes of an encoded state
+    uint64_t capacity; // number of slots, a power of two
+    uint64_t count; // number of stored states, updated atomically
+};
+
+template<class StateT>
+class mapped_store : public visited_store<StateT> {
+private:
+    // Slot tags, a slot is claimed by moving it from empty to writing and published by moving it to full
+    enum : uint32_t {
+        empty = 0, writing = 1, full = 2
+    };
+
+    void *_mapping = nullptr;
+    size_t _length = 0;
+    bool _readOnly;
+    mapped_store_header *_header = nullptr;
+    char *_slots = nullptr;
+    size_t _stride = 0; // bytes per slot: tag, fingerprint and record, padded to 8 bytes
+    mutable std::string _record;
+    mutable std::unordered_set<size_t> _stale; // slots left writing by a writer that did not finish
+
+    // Writing a record takes a memcpy, a slot writing for longer than this was abandoned
+    static constexpr std::chrono::milliseconds stale_after{100};
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "Slot tags must be lock free atomics to be shared between processes.");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+                  "The count must be a lock free atomic to be shared between processes.");
+
+    std::atomic<uint32_t> &tag(size_t slot) const {
+        return *reinterpret_cast<std::atomic<uint32_t> *>(_slots + slot * _stride);
+    }
+
+    uint32_t &fingerprint(size_t slot) const {
+        return *reinterpret_cast<uint32_t *>(_slots + slot * _stride + sizeof(uint32_t));
+    }
+
+    char *record(size_t slot) const {
+        return _slots + slot * _stride + 2 * sizeof(uint32_t);
+    }
+
+    std::atomic<uint64_t> &count() const {
+        return *reinterpret_cast<std::atomic<uint64_t> *>(&_header->count);
+    }
+
+    // Packs the state into _record and returns the fingerprint, which is never 0 so it can not be confused
+    uint32_t pack(const StateT &state) const {
+        _record.clear();
+        state_codec<StateT>::encode(state, _record);
+        if (_record.size() > _header->recordSize) {
+            throw std::length_error("State does not fit into the records of the mapped store.");
+        }
+        _record.resize(_header->recordSize, '\0');
+        return static_cast<uint32_t>(state_hash(state) >> 32) | 1;
+    }
+
+    // Waits for a slot being written by another process or thread and returns its final tag. A writer that was
+    // killed leaves its slot writing forever, so after stale_after the slot is given up on and remembered: it is
+    // still writing and probes go past it as if it held another state.
+    uint32_t settled(size_t slot) const {
+        auto current = tag(slot).load(std::memory_order_acquire);
+        if (current != writing || _stale.count(slot) != 0) {
+            return current;
+        }
+        auto deadline = std::chrono::steady_clock::now() + stale_after;
+        while (current == writing) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                _stale.insert(slot);
+                break;
+            }
+            std::this_thread::yield();
+            current = tag(slot).load(std::memory_order_acquire);
+        }
+        return current;
+    }
+
+    bool matches(size_t slot, uint32_t print) const {
+        return fingerprint(slot) == print && std::memcmp(record(slot), _record.data(), _record.size()) == 0;
+    }
+
+    void map(const std::string &path, int fd) {
+        struct stat info{};
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(mapped_store_header)) {
+            ::close(fd);
+            throw std::runtime_error("Not a mapped store: " + path);
+        }
+        _length = static_cast<size_t>(info.st_size);
+        _mapping = ::mmap(nullptr, _length, _readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (_mapping == MAP_FAILED) {
+            _mapping = nullptr;
+            throw std::runtime_error("Could not map the store " + path);
+        }
+        _header = static_cast<mapped_store_header *>(_mapping);
+        _stride = (2 * sizeof(uint32_t) + _header->recordSize + 7) / 8 * 8;
+        if (!std::equal(std::begin(mapped_store_magic), std::end(mapped_store_magic), _header->magic) ||
+            _length != sizeof(mapped_store_header) + _header->capacity * _stride) {
+            ::munmap(_mapping, _length);
+            _mapping = nullptr;
+            throw std::runtime_error("Not a mapped store: " + path);
+        }
+        _slots = static_cast<char *>(_mapping) + sizeof(mapped_store_header);
+    }
+
+public:
+    // Opens the store in the file for reading and writing, creating it with room for capacity states of
+    // recordSize encoded bytes if it does not exist. An existing file keeps its states, capacity and record size.
+    mapped_store(const std::string &path, size_t capacity, size_t recordSize) : _readOnly(false) {
+        auto fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open the store " + path);
+        }
+        // Only one process may initialize a new file
+        ::flock(fd, LOCK_EX);
+        struct stat info{};
+        if (::fstat(fd, &info) == 0 && info.st_size == 0) {
+            size_t slots = 16;
+            while (slots < capacity * 2) { // keep the load factor at or below one half
+                slots *= 2;
+            }
+            mapped_store_header header{};
+            std::copy(std::begin(mapped_store_magic), std::end(mapped_store_magic), header.magic);
+            header.recordSize = recordSize;
+            header.capacity = slots;
+            auto stride = (2 * sizeof(uint32_t) + recordSize + 7) / 8 * 8;
+            // The new slots read as zero, which is the empty tag
+            if (::ftruncate(fd, static_cast<off_t>(sizeof(header) + slots * stride)) != 0 ||
+                ::pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+                ::close(fd);
+                throw std::runtime_error("Could not create the store " + path);
+            }
+        }
+        ::flock(fd, LOCK_UN);
+        map(path, fd);
+    }
+
+    // Opens the store in the file read-only, it can be looked up but not inserted into
+    explicit mapped_store(const std::string &path) : _readOnly(true) {
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open the store " + path);
+        }
+        map(path, fd);
+    }
+
+    mapped_store(const mapped_store &) = delete;
+
+    mapped_store &operator=(const mapped_store &) = delete;
+
+    ~mapped_store() override {
+        if (_mapping != nullptr) {
+            ::munmap(_mapping, _length);
+        }
+    }
+
+    bool insert(const StateT &state) override {
+        if (_readOnly) {
+            throw std::logic_error("Can not insert into a read-only mapped store.");
+        }
+        auto print = pack(state);
+        auto mask = _header->capacity - 1;
+        for (auto slot = state_hash(state) & mask, probes = size_t{0}; probes <= mask; slot = (slot + 1) & mask, ++probes) {
+            auto current = tag(slot).load(std::memory_order_acquire);
+            if (current == empty) {
+                uint32_t expected = empty;
+                if (tag(slot).compare_exchange_strong(expected, writing, std::memory_order_acq_rel)) {
+                    fingerprint(slot) = print;
+                    std::memcpy(record(slot), _record.data(), _record.size());
+                    tag(slot).store(full, std::memory_order_release);
+                    count().fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                current = expected;
+            }
+            if (current == writing) {
+                current = settled(slot);
+            }
+            if (current == full && matches(slot, print)) {
+                return false;
+            }
+        }
+        throw std::length_error("The mapped store is full.");
+    }
+
+    bool contains(const StateT &state) const override {
+        auto print = pack(state);
+        auto mask = _header->capacity - 1;
+        for (auto slot = state_hash(state) & mask, probes = size_t{0}; probes <= mask; slot = (slot + 1) & mask, ++probes) {
+            auto current = settled(slot);
+            if (current == empty) {
+                return false;
+            }
+            if (current == full && matches(slot, print)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Removes all states from the file, other processes using it must not insert meanwhile
+    void clear() override {
+        if (_readOnly) {
+            throw std::logic_error("Can not clear a read-only mapped store.");
+        }
+        std::memset(_slots, 0, _header->capacity * _stride);
+        _stale.clear();
+        count().store(0, std::memory_order_release);
+    }
+
+    size_t size() const override { return count().load(std::memory_order_acquire); }
+
+    // Write the stored states to the file now rather than when the OS decides to
+    void flush() {
+        ::msync(_mapping, _length, MS_SYNC);
+    }
+};
+
+#endif //PUZZLEENGINE_MAPPED_STORE_HPP
@@ -0,0 +1,166 @@
+/**
+ * Pattern databases: admissible heuristics from an abstraction of the states, built once and memory-mapped.
+ * An abstraction maps every state to an abstract state, such that every transition either leaves the abstract
+ * state unchanged or is matched by an abstract transition. The number of abstract transitions to an abstract goal
+ * is then a lower bound on the number of transitions to a goal, which the cost solver can use with use_heuristic.
+ *
+ * The abstract states are numbered 0..size-1 by a rank function and its inverse. The builder expands every abstract
+ * state, runs a backward breadth-first search from the abstract goals over the reversed transitions and writes the
+ * distances with one byte per abstract state. A pattern_database maps such a file into memory read-only, so lookups
+ * are O(1), the pages are shared between processes and only the pages actually used are read from disk.
+ */
+
+#ifndef PUZZLEENGINE_PATTERN_DATABASE_HPP
+#define PUZZLEENGINE_PATTERN_DATABASE_HPP
+
+#include "reachability.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept> // For runtime_error
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h> // For fstat
+#include <fcntl.h> // For open
+#include <unistd.h> // For close
+
+// Identifies pattern database files and their layout version
+constexpr char pattern_database_magic[8] = {'P', 'D', 'B', 'v', '1', 0, 0, 0};
+
+struct pattern_database_header {
+    char magic[8];
+    uint64_t size; // number of abstract states, followed by one distance byte for each
+};
+
+// Builds the pattern database of an abstraction and writes it to path.
+// unrank turns the numbers 0..size-1 into abstract states and rank is its inverse, transitions are the abstract
+// transitions and isGoal tells the abstract goals. Distances above 254 are stored as 254, abstract states that can
+// not reach a goal get pattern_database::unreachable. The predecessors are kept as 32 bit ranks, so size must not
+// exceed 2^32.
+template<class AbstractT, template<class...> class ContainerT, class GoalF>
+void build_pattern_database(
+        const std::string &path,
+        size_t size,
+        std::function<AbstractT(size_t)> unrank,
+        std::function<size_t(const AbstractT &)> rank,
+        std::function<ContainerT<std::function<void(AbstractT &)>>(AbstractT &)> transitions,
+        GoalF isGoal) {
+    if (size > uint64_t{UINT32_MAX} + 1) {
+        throw std::length_error("Pattern databases are limited to 2^32 abstract states.");
+    }
+    // Reversed transitions in compressed rows: the predecessors of r are sources[offsets[r]..offsets[r + 1]).
+    // Two passes over the transitions, the first counts the predecessors and the second fills them in.
+    std::vector<uint64_t> offsets(size + 1, 0);
+    auto forEachEdge = [&](auto visit) {
+        for (size_t from = 0; from < size; ++from) {
+            auto state = unrank(from);
+            for (auto &transition: transitions(state)) {
+                auto successor{state};
+                transition(successor);
+                auto to = rank(successor);
+                if (to != from) {
+                    visit(from, to);
+                }
+            }
+        }
+    };
+    forEachEdge([&](size_t, size_t to) { ++offsets[to + 1]; });
+    for (size_t r = 0; r < size; ++r) {
+        offsets[r + 1] += offsets[r];
+    }
+    std::vector<uint32_t> sources(offsets[size]);
+    std::vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+    forEachEdge([&](size_t from, size_t to) { sources[fill[to]++] = static_cast<uint32_t>(from); });
+
+    // Backward breadth-first search from all abstract goals at once
+    std::vector<uint8_t> distances(size, 255);
+    std::vector<uint32_t> frontier;
+    for (size_t r = 0; r < size; ++r) {
+        if (isGoal(unrank(r))) {
+            distances[r] = 0;
+            frontier.push_back(static_cast<uint32_t>(r));
+        }
+    }
+    for (uint8_t distance = 1; !frontier.empty(); distance = distance < 254 ? distance + 1 : 254) {
+        std::vector<uint32_t> next;
+        for (auto r: frontier) {
+            for (auto i = offsets[r]; i < offsets[r + 1]; ++i) {
+                if (distances[sources[i]] == 255) {
+                    distances[sources[i]] = distance;
+                    next.push_back(sources[i]);
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+
+    pattern_database_header header{};
+    std::copy(std::begin(pattern_database_magic), std::end(pattern_database_magic), header.magic);
+    header.size = size;
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(distances.data()), distances.size());
+    if (!file) {
+        throw std::runtime_error("Could not write the pattern database " + path);
+    }
+}
+
+// A pattern database file mapped into memory read-only
+class pattern_database {
+private:
+    void *_mapping = nullptr;
+    size_t _length = 0;
+    const uint8_t *_distances = nullptr;
+    size_t _size = 0;
+
+public:
+    // Distance of abstract states that can not reach an abstract goal
+    static constexpr uint8_t unreachable = 255;
+
+    explicit pattern_database(const std::string &path) {
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open the pattern database " + path);
+        }
+        struct stat info{};
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(pattern_database_header)) {
+            ::close(fd);
+            throw std::runtime_error("Not a pattern database: " + path);
+        }
+        _length = static_cast<size_t>(info.st_size);
+        _mapping = ::mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (_mapping == MAP_FAILED) {
+            _mapping = nullptr;
+            throw std::runtime_error("Could not map the pattern database " + path);
+        }
+        auto header = static_cast<const pattern_database_header *>(_mapping);
+        if (!std::equal(std::begin(pattern_database_magic), std::end(pattern_database_magic), header->magic) ||
+            _length != sizeof(pattern_database_header) + header->size) {
+            ::munmap(_mapping, _length);
+            throw std::runtime_error("Not a pattern database: " + path);
+        }
+        _size = header->size;
+        _distances = static_cast<const uint8_t *>(_mapping) + sizeof(pattern_database_header);
+    }
+
+    pattern_database(const pattern_database &) = delete;
+
+    pattern_database &operator=(const pattern_database &) = delete;
+
+    ~pattern_database() {
+        if (_mapping != nullptr) {
+            ::munmap(_mapping, _length);
+        }
+    }
+
+    // Lower bound on the number of transitions to a goal from the abstract state with the given rank
+    uint8_t operator[](size_t rank) const {
+        assert(rank < _size && "Rank out of range of the pattern database.");
+        return _distances[rank];
+    }
+
+    size_t size() const { return _size; }
+};
+
+#endif //PUZZLEENGINE_PATTERN_DATABASE_HPP
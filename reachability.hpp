@@ -17,12 +17,37 @@
 #include <functional> // For function
 #include <iostream> // For cout
 #include <memory> // For smart pointers
+#include <memory_resource> // For polymorphic allocators
+#include <vector> // For vector
+#include <deque> // For deque
+#include <string> // For string
+#include <string_view> // For string_view
+#include <unordered_map> // For unordered_map
+#include <unordered_set> // For unordered_set
+#include <type_traits> // For type traits
+#include <algorithm> // For find
+#include <cassert> // For assert
+#include <cstdint> // For fixed width integers
+#include <cstring> // For memcpy
+#include <array> // For array
+#include <chrono> // For profiling clock
+#include <iomanip> // For setprecision
+#include <atomic> // For atomic
+#include <future> // For future and async
+#include <stdexcept> // For out_of_range and invalid_argument
+#include <optional> // For optional
 
 // Search order enum for requirement 4
 enum class search_order {
     breadth_first, depth_first
 };
 
+// When the solvers look for states that were seen before
+enum class duplicate_detection {
+    on_expansion, // when a state is taken from the waiting list, the waiting list may hold many copies of a state
+    on_generation // when a successor is generated, so every state enters the waiting list at most once
+};
+
 // Requirement 1: A generic successor generator function.
 template<class StateT, template<class...> class ContainerT>
 std::function<ContainerT<std::function<void(StateT &)>>(StateT &)>
@@ -30,6 +55,171 @@ successors(ContainerT<std::function<void(StateT &)>> (*transitions)(const StateT
     return transitions;
 }
 
+// Phases of the search loops that can be profiled
+enum class search_phase {
+    pop, goal, dedup, transitions, successor, invariant, cost, push
+};
+
+// Hot path profiling of the search loops. Define ENABLE_PROFILING before including this header to enable it,
+// otherwise the hooks compile to nothing. The profiler types and use_profiler exist either way, so state_space_t
+// has the same layout in translation units that disagree on the macro.
+
+// Collects sampled phase timings, only every n-th iteration of a search loop is timed to keep the overhead low.
+// A profiler is not synchronized, use one per thread.
+class search_profiler {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    explicit search_profiler(size_t sampleEvery = 64) : _sampleEvery(sampleEvery == 0 ? 1 : sampleEvery) {}
+
+    // Called once per iteration, returns whether the phases of this iteration should be timed
+    bool sample() { return _iterations++ % _sampleEvery == 0; }
+
+    void record(search_phase phase, clock_t::time_point begin, clock_t::time_point end) {
+        auto &total = _totals[static_cast<size_t>(phase)];
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+        ++total.samples;
+        total.nanoseconds += duration;
+        _events.push_back(event_t{phase, std::chrono::duration_cast<std::chrono::nanoseconds>(begin - _start).count(),
+                                  duration});
+    }
+
+    // Chrome trace event format, open with chrome://tracing or https://ui.perfetto.dev
+    void write_chrome_trace(std::ostream &os) const {
+        // Timestamps are in microseconds, keep the nanoseconds as decimals
+        auto flags = os.flags();
+        auto precision = os.precision();
+        os << std::fixed << std::setprecision(3);
+        os << "{\"traceEvents\":[";
+        for (size_t i = 0; i < _events.size(); ++i) {
+            os << (i == 0 ? "" : ",")
+               << "\n{\"name\":\"" << name(_events[i].phase) << "\",\"cat\":\"search\",\"ph\":\"X\""
+               << ",\"ts\":" << _events[i].begin / 1000.0 << ",\"dur\":" << _events[i].duration / 1000.0
+               << ",\"pid\":1,\"tid\":1}";
+        }
+        os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+        os.flags(flags);
+        os.precision(precision);
+    }
+
+    // Flat profile with one line per phase, the totals only cover the sampled iterations
+    void write_csv(std::ostream &os) const {
+        os << "phase,samples,total_ns,mean_ns\n";
+        for (size_t i = 0; i < _totals.size(); ++i) {
+            auto &total = _totals[i];
+            os << name(static_cast<search_phase>(i)) << ',' << total.samples << ',' << total.nanoseconds << ','
+               << (total.samples == 0 ? 0 : total.nanoseconds / total.samples) << '\n';
+        }
+    }
+
+    void clear() {
+        _events.clear();
+        _totals = {};
+        _iterations = 0;
+        _start = clock_t::now();
+    }
+
+private:
+    struct event_t {
+        search_phase phase;
+        int64_t begin;
+        int64_t duration;
+    };
+    struct total_t {
+        size_t samples{0};
+        int64_t nanoseconds{0};
+    };
+
+    size_t _sampleEvery;
+    size_t _iterations = 0;
+    clock_t::time_point _start = clock_t::now();
+    std::vector<event_t> _events;
+    std::array<total_t, 8> _totals{};
+
+    static const char *name(search_phase phase) {
+        switch (phase) {
+            case search_phase::pop:
+                return "pop";
+            case search_phase::goal:
+                return "goal";
+            case search_phase::dedup:
+                return "dedup";
+            case search_phase::transitions:
+                return "transitions";
+            case search_phase::successor:
+                return "successor";
+            case search_phase::invariant:
+                return "invariant";
+            case search_phase::cost:
+                return "cost";
+            case search_phase::push:
+                return "push";
+        }
+        return "unknown";
+    }
+};
+
+// Times the enclosing scope if the current iteration is sampled
+class scoped_phase {
+private:
+    search_profiler *_profiler;
+    search_phase _phase;
+    search_profiler::clock_t::time_point _begin;
+
+public:
+    scoped_phase(search_profiler *profiler, bool sampled, search_phase phase)
+            : _profiler(sampled ? profiler : nullptr), _phase(phase) {
+        if (_profiler != nullptr) {
+            _begin = search_profiler::clock_t::now();
+        }
+    }
+
+    ~scoped_phase() {
+        if (_profiler != nullptr) {
+            _profiler->record(_phase, _begin, search_profiler::clock_t::now());
+        }
+    }
+};
+
+#ifdef ENABLE_PROFILING
+#define PUZZLEENGINE_CONCAT_(a, b) a##b
+#define PUZZLEENGINE_CONCAT(a, b) PUZZLEENGINE_CONCAT_(a, b)
+// Starts an iteration of a search loop and decides whether it is sampled
+#define PROFILE_ITERATION() const bool profileSampled = _profiler != nullptr && _profiler->sample()
+// Times the rest of the enclosing scope as the given phase
+#define PROFILE_PHASE(phase) \
+    scoped_phase PUZZLEENGINE_CONCAT(profilePhase, __LINE__){_profiler, profileSampled, search_phase::phase}
+#else
+#define PROFILE_ITERATION()
+#define PROFILE_PHASE(phase)
+#endif
+
+// Cooperative cancellation of a search, copies share the same flag so one can be handed to the search.
+class cancellation_token {
+private:
+    std::shared_ptr<std::atomic<bool>> _cancelled = std::make_shared<std::atomic<bool>>(false);
+
+public:
+    void cancel() { _cancelled->store(true, std::memory_order_relaxed); }
+
+    bool cancelled() const { return _cancelled->load(std::memory_order_relaxed); }
+};
+
+// Snapshot of a running search given to the progress callback
+struct search_progress {
+    size_t expanded; // states expanded so far
+    size_t frontier; // states in the waiting list
+    size_t depth; // length of the trace of the last expanded state
+};
+
+// Lets the caller of a search cancel it and observe it. The search polls the token every iteration and calls
+// progress every progressEvery expansions from the thread running the search.
+struct search_control {
+    cancellation_token token;
+    std::function<void(const search_progress &)> progress = nullptr;
+    size_t progressEvery = 1000;
+};
+
 // Struct to save the current trace.
 template<class StateT>
 struct trace_state {
@@ -37,6 +227,476 @@ struct trace_state {
     StateT self;
 };
 
+// splitmix64 finalizer, spreads the bits of a 64 bit key
+inline uint64_t mix64(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+}
+
+// FNV-1a over raw bytes
+inline uint64_t hash_bytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    auto bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Detects states that carry their own hash through a `size_t hash() const` member
+template<class StateT, class = void>
+struct carries_hash : std::false_type {
+};
+
+template<class StateT>
+struct carries_hash<StateT, std::void_t<decltype(std::declval<const StateT &>().hash())>> : std::true_type {
+};
+
+// Hash of a state. States carrying their hash, e.g. updated incrementally with zobrist_keys by the transitions,
+// are hashed in O(1). Other states fall back to a full hash: std::hash if it exists, otherwise the bytes of a
+// trivially copyable state or of the elements of a contiguous container. The byte hash assumes there is no padding.
+template<class StateT>
+size_t state_hash(const StateT &state) {
+    if constexpr (carries_hash<StateT>::value) {
+        return state.hash();
+    } else if constexpr (std::is_default_constructible<std::hash<StateT>>::value) {
+        return std::hash<StateT>{}(state);
+    } else if constexpr (std::is_trivially_copyable<StateT>::value) {
+        return hash_bytes(&state, sizeof(StateT));
+    } else {
+        using value_t = typename StateT::value_type;
+        static_assert(std::is_trivially_copyable<value_t>::value,
+                      "StateT must carry a hash, have std::hash or consist of trivially copyable values.");
+        return hash_bytes(state.data(), sizeof(value_t) * state.size());
+    }
+}
+
+// Hash functor for containers of states
+struct state_hasher {
+    template<class StateT>
+    size_t operator()(const StateT &state) const { return state_hash(state); }
+};
+
+// Turns states into bytes and back, used to send states between processes and to store them in files.
+// Works for trivially copyable states and for contiguous containers of trivially copyable values, specialize it
+// for other states.
+template<class StateT, class = void>
+struct state_codec {
+    static void encode(const StateT &state, std::string &out) {
+        if constexpr (std::is_trivially_copyable<StateT>::value) {
+            out.append(reinterpret_cast<const char *>(&state), sizeof(StateT));
+        } else {
+            using value_t = typename StateT::value_type;
+            static_assert(std::is_trivially_copyable<value_t>::value,
+                          "StateT must be trivially copyable or consist of trivially copyable values.");
+            auto size = static_cast<uint32_t>(state.size());
+            out.append(reinterpret_cast<const char *>(&size), sizeof(size));
+            out.append(reinterpret_cast<const char *>(state.data()), sizeof(value_t) * size);
+        }
+    }
+
+    // Reads a state and moves the input past it
+    static StateT decode(const char *&in) {
+        StateT state{};
+        if constexpr (std::is_trivially_copyable<StateT>::value) {
+            std::memcpy(&state, in, sizeof(StateT));
+            in += sizeof(StateT);
+        } else {
+            using value_t = typename StateT::value_type;
+            uint32_t size;
+            std::memcpy(&size, in, sizeof(size));
+            in += sizeof(size);
+            state.resize(size);
+            std::memcpy(state.data(), in, sizeof(value_t) * size);
+            in += sizeof(value_t) * size;
+        }
+        return state;
+    }
+};
+
+// Random keys for Zobrist hashing, one for every value of every field of a state. A state that carries the xor of
+// the keys of its field values can update its hash in O(1) whenever a transition changes a field.
+class zobrist_keys {
+private:
+    size_t _values;
+    std::vector<uint64_t> _keys;
+
+public:
+    zobrist_keys(size_t fields, size_t values, uint64_t seed = 0x9e3779b97f4a7c15ULL)
+            : _values(values), _keys(fields * values) {
+        for (auto &key: _keys) {
+            seed += 0x9e3779b97f4a7c15ULL; // splitmix64 sequence
+            key = mix64(seed);
+        }
+    }
+
+    size_t fields() const { return _keys.size() / _values; }
+
+    // Throws out_of_range for fields or values the keys were not made for, e.g. states larger than planned
+    uint64_t operator()(size_t field, size_t value) const {
+        if (value >= _values || field * _values + value >= _keys.size()) {
+            throw std::out_of_range("Field or value out of range of the Zobrist keys.");
+        }
+        return _keys[field * _values + value];
+    }
+
+    // What to xor into the hash when a field changes from one value to another
+    uint64_t update(size_t field, size_t from, size_t to) const {
+        return (*this)(field, from) ^ (*this)(field, to);
+    }
+};
+
+// Interface for the set of passed states, so the storage strategy can be changed without touching the solvers.
+template<class StateT>
+class visited_store {
+public:
+    virtual ~visited_store() = default;
+    // Adds the state and returns true if it was not stored already.
+    virtual bool insert(const StateT &state) = 0;
+    virtual bool contains(const StateT &state) const = 0;
+    virtual void clear() = 0;
+    virtual size_t size() const = 0;
+};
+
+// The default store: a plain list of passed states searched linearly, only requires operator==.
+template<class StateT>
+class list_store : public visited_store<StateT> {
+private:
+    std::pmr::list<StateT> _states;
+
+public:
+    explicit list_store(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : _states(resource) {}
+
+    bool insert(const StateT &state) override {
+        if (contains(state)) {
+            return false;
+        }
+        _states.push_back(state);
+        return true;
+    }
+
+    bool contains(const StateT &state) const override {
+        return std::find(_states.begin(), _states.end(), state) != _states.end();
+    }
+
+    void clear() override { _states.clear(); }
+
+    size_t size() const override { return _states.size(); }
+};
+
+// Store of passed states in a hash set, needs state_hash to work for the state and operator== to compare.
+template<class StateT>
+class hash_store : public visited_store<StateT> {
+private:
+    std::pmr::unordered_set<StateT, state_hasher> _states;
+
+public:
+    explicit hash_store(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : _states(0, state_hasher{}, std::equal_to<StateT>{}, resource) {}
+
+    bool insert(const StateT &state) override { return _states.insert(state).second; }
+
+    bool contains(const StateT &state) const override { return _states.find(state) != _states.end(); }
+
+    // Keeps the buckets, so the store can be reused between searches
+    void clear() override { _states.clear(); }
+
+    size_t size() const override { return _states.size(); }
+};
+
+// Views the raw bytes of a trivially copyable value as a component for the collapse store.
+template<class T>
+std::string_view component_of(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Component must be trivially copyable.");
+    return std::string_view{reinterpret_cast<const char *>(&value), sizeof(T)};
+}
+
+// Views the raw bytes of a contiguous range [first, last) as a component for the collapse store.
+template<class T>
+std::string_view component_of(const T *first, const T *last) {
+    static_assert(std::is_trivially_copyable<T>::value, "Component must be trivially copyable.");
+    return std::string_view{reinterpret_cast<const char *>(first), sizeof(T) * (last - first)};
+}
+
+// Compact open addressing table interning 64 bit keys as dense 32 bit ids. Used for the inner nodes of the
+// collapse tree, where an entry costs a key and a slot instead of a heap allocated node.
+class collapse_table {
+private:
+    std::vector<uint64_t> _keys; // id -> key
+    std::vector<uint32_t> _slots; // 0 is empty, otherwise id + 1
+
+    void grow() {
+        std::vector<uint32_t> slots(_slots.empty() ? 16 : _slots.size() * 2, 0);
+        auto mask = slots.size() - 1;
+        for (uint32_t id = 0; id < _keys.size(); ++id) {
+            auto i = mix64(_keys[id]) & mask;
+            while (slots[i] != 0) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = id + 1;
+        }
+        _slots.swap(slots);
+    }
+
+public:
+    // Returns the id of the key and whether it was added by this call.
+    std::pair<uint32_t, bool> intern(uint64_t key) {
+        // Keep the load factor at or below one half
+        if ((_keys.size() + 1) * 2 > _slots.size()) {
+            grow();
+        }
+        auto mask = _slots.size() - 1;
+        auto i = mix64(key) & mask;
+        while (_slots[i] != 0) {
+            if (_keys[_slots[i] - 1] == key) {
+                return {_slots[i] - 1, false};
+            }
+            i = (i + 1) & mask;
+        }
+        _keys.push_back(key);
+        _slots[i] = static_cast<uint32_t>(_keys.size());
+        return {_slots[i] - 1, true};
+    }
+
+    // Returns the id of the key or -1 if it is unknown.
+    int64_t find(uint64_t key) const {
+        if (_slots.empty()) {
+            return -1;
+        }
+        auto mask = _slots.size() - 1;
+        auto i = mix64(key) & mask;
+        while (_slots[i] != 0) {
+            if (_keys[_slots[i] - 1] == key) {
+                return _slots[i] - 1;
+            }
+            i = (i + 1) & mask;
+        }
+        return -1;
+    }
+
+    // Forget all keys but keep the memory, so the table can be reused by the next search.
+    void clear() {
+        _keys.clear();
+        std::fill(_slots.begin(), _slots.end(), 0);
+    }
+
+    size_t size() const { return _keys.size(); }
+};
+
+// Collapse (tree) compression of passed states as in SPIN's COLLAPSE mode and LTSmin's tree compression.
+// A split function cuts every state into the same number of components. Each distinct component is stored once
+// in the table of its position, and the component ids are then interned pairwise up a binary tree, so a new state
+// only costs the tree nodes it does not share with the states seen before. Lookups stay exact.
+template<class StateT>
+class collapse_store : public visited_store<StateT> {
+public:
+    using components_t = std::vector<std::string_view>;
+    using split_t = std::function<void(const StateT &, components_t &)>;
+
+private:
+    split_t _split;
+    std::vector<std::deque<std::string>> _leafData; // Owns the component bytes, deque keeps the views stable
+    std::vector<std::unordered_map<std::string_view, uint32_t>> _leaves;
+    std::vector<collapse_table> _nodes; // Inner nodes of the tree, the last one is the root
+    size_t _size = 0;
+    mutable components_t _parts;
+    mutable std::vector<uint32_t> _ids;
+
+    static uint64_t pack(uint32_t left, uint32_t right) {
+        return (static_cast<uint64_t>(left) << 32) | right;
+    }
+
+public:
+    explicit collapse_store(split_t split) : _split(std::move(split)) {}
+
+    bool insert(const StateT &state) override {
+        _parts.clear();
+        _split(state, _parts);
+        if (_parts.empty()) {
+            throw std::invalid_argument("The split function must produce at least one component.");
+        }
+        if (_size == 0 && _leaves.size() != _parts.size()) {
+            _leaves.assign(_parts.size(), {});
+            _leafData.assign(_parts.size(), {});
+            _nodes.assign(_parts.size() - 1, {});
+        }
+        if (_parts.size() != _leaves.size()) {
+            throw std::invalid_argument("The split function must always produce the same number of components.");
+        }
+
+        bool added = false;
+        _ids.clear();
+        for (size_t i = 0; i < _parts.size(); ++i) {
+            auto found = _leaves[i].find(_parts[i]);
+            if (found != _leaves[i].end()) {
+                _ids.push_back(found->second);
+                added = false;
+            } else {
+                auto &bytes = _leafData[i].emplace_back(_parts[i]);
+                auto id = static_cast<uint32_t>(_leaves[i].size());
+                _leaves[i].emplace(std::string_view{bytes}, id);
+                _ids.push_back(id);
+                added = true;
+            }
+        }
+        // Fold the ids pairwise until only the root is left, the root decides if the state is new.
+        size_t node = 0;
+        while (_ids.size() > 1) {
+            size_t next = 0;
+            for (size_t i = 0; i + 1 < _ids.size(); i += 2) {
+                auto interned = _nodes[node++].intern(pack(_ids[i], _ids[i + 1]));
+                _ids[next++] = interned.first;
+                added = interned.second;
+            }
+            if (_ids.size() % 2 == 1) {
+                _ids[next++] = _ids.back();
+            }
+            _ids.resize(next);
+        }
+        if (added) {
+            ++_size;
+        }
+        return added;
+    }
+
+    bool contains(const StateT &state) const override {
+        if (_size == 0) {
+            return false;
+        }
+        _parts.clear();
+        _split(state, _parts);
+        // A state with another number of components can not have been stored
+        if (_parts.size() != _leaves.size()) {
+            return false;
+        }
+        _ids.clear();
+        for (size_t i = 0; i < _parts.size(); ++i) {
+            auto found = _leaves[i].find(_parts[i]);
+            if (found == _leaves[i].end()) {
+                return false;
+            }
+            _ids.push_back(found->second);
+        }
+        size_t node = 0;
+        while (_ids.size() > 1) {
+            size_t next = 0;
+            for (size_t i = 0; i + 1 < _ids.size(); i += 2) {
+                auto id = _nodes[node++].find(pack(_ids[i], _ids[i + 1]));
+                if (id < 0) {
+                    return false;
+                }
+                _ids[next++] = static_cast<uint32_t>(id);
+            }
+            if (_ids.size() % 2 == 1) {
+                _ids[next++] = _ids.back();
+            }
+            _ids.resize(next);
+        }
+        return true;
+    }
+
+    // Keeps the tables allocated, so one store can be reused between searches.
+    void clear() override {
+        for (auto &data: _leafData) {
+            data.clear();
+        }
+        for (auto &leaves: _leaves) {
+            leaves.clear();
+        }
+        for (auto &node: _nodes) {
+            node.clear();
+        }
+        _size = 0;
+    }
+
+    size_t size() const override { return _size; }
+};
+
+// Entry of the waiting queue of the cost solver, ordered by the priority only. The priority is the cost, plus the
+// estimate of the remaining cost when a heuristic is used.
+template<class StateT, class CostT>
+struct cost_entry {
+    CostT priority;
+    CostT cost;
+    std::shared_ptr<trace_state<StateT>> trace;
+
+    bool operator<(const cost_entry &other) const { return priority < other.priority; }
+};
+
+// Maps the costs of a cost type to integers that are smaller for the costs the cost solver should expand first.
+// Specialize it with enabled set and a key function for costs that never decrease along a trace, e.g. a depth or a
+// sum of non-negative penalties, and the cost solver queues the waiting states in a radix_queue.
+template<class CostT, class = void>
+struct cost_key {
+    static constexpr bool enabled = false;
+};
+
+// Monotone priority queue over integer keys (radix heap). Every pushed key must be at least the key popped last,
+// push throws logic_error otherwise, as the entries would no longer come out in order.
+// Entries go to the bucket of the highest bit in which their key differs from the last popped key, and only the
+// first nonempty bucket is redistributed when the lowest bucket runs out, so an entry moves down at most 64 times.
+// Pops entries with the same key last in, first out.
+template<class EntryT, class KeyF>
+class radix_queue {
+private:
+    using slot_t = std::pair<uint64_t, EntryT>;
+    KeyF _key;
+    std::vector<std::pmr::vector<slot_t>> _buckets;
+    uint64_t _last = 0;
+    size_t _size = 0;
+
+    size_t bucket(uint64_t key) const {
+        return key == _last ? 0 : 64 - __builtin_clzll(key ^ _last);
+    }
+
+public:
+    explicit radix_queue(KeyF key, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : _key(std::move(key)) {
+        _buckets.reserve(65);
+        for (size_t b = 0; b < 65; ++b) {
+            _buckets.emplace_back(resource);
+        }
+    }
+
+    void push(EntryT entry) {
+        auto key = _key(entry);
+        if (key < _last) {
+            throw std::logic_error("Keys of a radix_queue must not decrease, the costs or the heuristic are not "
+                                   "monotone.");
+        }
+        _buckets[bucket(key)].emplace_back(key, std::move(entry));
+        ++_size;
+    }
+
+    // Moves the entries with the least key to the lowest bucket first
+    EntryT &top() {
+        assert(_size > 0 && "top of an empty radix_queue.");
+        if (_buckets[0].empty()) {
+            auto next = std::find_if(_buckets.begin() + 1, _buckets.end(), [](auto &b) { return !b.empty(); });
+            _last = std::min_element(next->begin(), next->end(),
+                                     [](auto &a, auto &b) { return a.first < b.first; })->first;
+            for (auto &slot: *next) {
+                _buckets[bucket(slot.first)].push_back(std::move(slot));
+            }
+            next->clear();
+        }
+        return _buckets[0].back().second;
+    }
+
+    void pop() {
+        top();
+        _buckets[0].pop_back();
+        --_size;
+    }
+
+    bool empty() const { return _size == 0; }
+
+    size_t size() const { return _size; }
+};
+
 // The state space class, uses a template class ContainerT to support any iterable container. (Requirement 7)
 template<class StateT, template<class...> class ContainerT, class CostT = std::nullptr_t>
 class state_space_t {
@@ -47,12 +707,120 @@ private:
     std::function<bool(const StateT &)> _invariantFunction;
     bool _useCost = false;
     std::function<CostT(const StateT &state, const CostT &cost)> _costFunction;
+    std::shared_ptr<visited_store<StateT>> _store;
+    std::shared_ptr<visited_store<StateT>> _record;
+    std::pmr::memory_resource *_resource = std::pmr::get_default_resource();
+    duplicate_detection _duplicates = duplicate_detection::on_expansion;
+    size_t _solutionLimit = 0;
+    std::function<CostT(const StateT &state, const CostT &cost)> _heuristicFunction;
+    std::optional<bool> _radixQueue; // chosen automatically unless set
+    search_profiler *_profiler = nullptr;
 
-    template<class ValidationF>
-    ContainerT<ContainerT<StateT>> solver(ValidationF isGoalState, search_order searchOrder);
+    // Returns the store to use for passed states, the default list store if none was supplied
+    std::shared_ptr<visited_store<StateT>> passedStore() {
+        auto store = _store ? _store : std::allocate_shared<list_store<StateT>>(
+                std::pmr::polymorphic_allocator<list_store<StateT>>{_resource}, _resource);
+        store->clear();
+        return store;
+    }
 
-    template<class ValidationF>
-    ContainerT<ContainerT<StateT>> costSolver(ValidationF isGoalState);
+    // Copies a state into the memory resource when the state supports it, e.g. a std::pmr::vector
+    StateT copyState(const StateT &state) const {
+        if constexpr (std::uses_allocator<StateT, std::pmr::polymorphic_allocator<std::byte>>::value) {
+            return StateT(state, std::pmr::polymorphic_allocator<std::byte>{_resource});
+        } else {
+            return state;
+        }
+    }
+
+    // Allocates a trace node and its control block from the memory resource
+    std::shared_ptr<trace_state<StateT>> makeTrace(std::shared_ptr<trace_state<StateT>> parent, StateT &&state) const {
+        return std::allocate_shared<trace_state<StateT>>(std::pmr::polymorphic_allocator<trace_state<StateT>>{_resource},
+                                                         trace_state<StateT>{std::move(parent), std::move(state)});
+    }
+
+    // The states from the initial state to the given one
+    ContainerT<StateT> makeSolution(const trace_state<StateT> *trace) const {
+        std::vector<const StateT *> states;
+        for (; trace != nullptr; trace = trace->parent.get()) {
+            states.push_back(&trace->self);
+        }
+        ContainerT<StateT> solution;
+        for (auto state = states.rbegin(); state != states.rend(); ++state) {
+            solution.push_back(**state);
+        }
+        return solution;
+    }
+
+    // Inserts an expanded state into the recording store, and stops recording when the store fails
+    void recordState(const StateT &state, bool &recording) const {
+        if (!recording) {
+            return;
+        }
+        try {
+            _record->insert(state);
+        } catch (const std::exception &) {
+            recording = false;
+        }
+    }
+
+    // Returns true if the search was cancelled, checked every iteration so runs of duplicates can be cancelled too
+    static bool cancelled(const search_control *control) {
+        return control != nullptr && control->token.cancelled();
+    }
+
+    // Returns true if the search should stop, and reports progress every progressEvery expansions
+    static bool poll(const search_control *control, size_t expanded, size_t frontier,
+                     const std::shared_ptr<trace_state<StateT>> &traceState) {
+        if (control == nullptr) {
+            return false;
+        }
+        if (control->progress && control->progressEvery > 0 && expanded % control->progressEvery == 0) {
+            size_t depth = 0;
+            for (auto trace = traceState.get(); trace != nullptr; trace = trace->parent.get()) {
+                ++depth;
+            }
+            control->progress(search_progress{expanded, frontier, depth});
+        }
+        return control->token.cancelled();
+    }
+
+    // The solvers pass every state they pop to reached, which records the goals and returns true to stop the search
+    template<class ReachedF>
+    void solver(ReachedF reached, search_order searchOrder, const search_control *control);
+
+    template<class ReachedF, class WaitingT>
+    void costSolver(ReachedF reached, const search_control *control, WaitingT &waiting);
+
+    // Runs the cost solver with a radix queue if the costs have a cost_key, or with a binary heap. A heuristic may
+    // lower the priorities along a trace, so then the radix queue is only used when asked for.
+    template<class ReachedF>
+    void costSolver(ReachedF reached, const search_control *control) {
+        using waiting_t = cost_entry<StateT, CostT>;
+        if constexpr (cost_key<CostT>::enabled) {
+            if (_radixQueue.value_or(!_heuristicFunction)) {
+                auto key = [](const waiting_t &entry) { return cost_key<CostT>::key(entry.priority); };
+                radix_queue<waiting_t, decltype(key)> waiting{key, _resource};
+                costSolver(reached, control, waiting);
+                return;
+            }
+        }
+        std::priority_queue<waiting_t, std::pmr::vector<waiting_t>> waiting{std::less<waiting_t>{},
+                                                                            std::pmr::vector<waiting_t>{_resource}};
+        costSolver(reached, control, waiting);
+    }
+
+    template<class ReachedF>
+    void search(ReachedF reached, search_order order, const search_control *control) {
+        // Only instantiate the cost solver when a cost type is given, nullptr_t has no ordering.
+        if constexpr (!std::is_same<CostT, std::nullptr_t>::value) {
+            if (_useCost) {
+                costSolver(reached, control);
+                return;
+            }
+        }
+        solver(reached, order, control);
+    }
 
 
 public:
@@ -96,159 +864,323 @@ public:
         _useCost = true;
     }
 
+    // Replace the default list of passed states, e.g. with a collapse_store to save memory on large state spaces.
+    // The store is cleared at the start of every check.
+    void use_store(std::shared_ptr<visited_store<StateT>> store) {
+        _store = std::move(store);
+    }
+
+    // Also insert every expanded state into the given store, which the searches never clear or look up. The store
+    // then collects the states reached by all checks, e.g. a mapped_store that later runs or other processes query
+    // with contains. Each check still finds all its traces on its own, nullptr stops recording. Recording is best
+    // effort: once the store fails to insert, e.g. a full mapped_store, the check goes on without recording.
+    void record_states(std::shared_ptr<visited_store<StateT>> store) {
+        _record = std::move(store);
+    }
+
+    // Detect duplicates when successors are generated rather than when they are expanded. For searches without cost
+    // every state is then queued at most once, breadth first still finds the same shortest traces, but each state
+    // reaches the goal predicate once, so fewer duplicate traces are reported. The store then also holds the queued
+    // and the invalid states, so the invariant is evaluated once per state. The cost solver can only skip successors
+    // that were expanded already, as a queued state may still be reached with a lower cost.
+    void detect_duplicates(duplicate_detection when) {
+        _duplicates = when;
+    }
+
+    // Stop the search once this many traces have been found, 0 searches the whole state space.
+    void limit_solutions(size_t limit) {
+        _solutionLimit = limit;
+    }
+
+    // Order the waiting queue of the cost solver by the returned priority instead of the cost, e.g. the cost plus an
+    // estimate of the remaining cost from a pattern_database (A*). The cost function still computes the costs. With
+    // an admissible and consistent estimate the first trace found is a cheapest one, so use limit_solutions(1).
+    void use_heuristic(std::function<CostT(const StateT &state, const CostT &cost)> heuristicFunction) {
+        _heuristicFunction = std::move(heuristicFunction);
+    }
+
+    // Queue the waiting states of the cost solver in a radix_queue when the cost type has a cost_key, or in a binary
+    // heap. By default the radix queue is used unless a heuristic is set. With a heuristic the priorities must never
+    // decrease along a trace (a consistent heuristic), otherwise the search throws logic_error.
+    void use_radix_queue(bool enable) {
+        _radixQueue = enable;
+    }
+
+    // Allocate all internal containers of the searches from the given resource, e.g. a monotonic buffer that is
+    // released after the search. The resource must outlive the calls to check, results are not allocated from it.
+    void use_resource(std::pmr::memory_resource *resource) {
+        _resource = resource;
+    }
+
+    // Time the phases of the search loops with the given profiler, nullptr turns it off again.
+    // Only records anything when ENABLE_PROFILING is defined.
+    void use_profiler(search_profiler *profiler) {
+        _profiler = profiler;
+    }
+
     // The function to call the solver, default search order is breadth_first, as a reasonable choice as defined in
     // requirement 8.
     template<class ValidationF>
     ContainerT<ContainerT<StateT>> check(
             ValidationF isGoalState,
             search_order order = search_order::breadth_first) {
+        return check(isGoalState, order, nullptr);
+    }
 
-        if (_useCost) {
-            return costSolver(isGoalState);
+    // Check that can be cancelled and observed through the control, a cancelled check returns the traces found so far
+    template<class ValidationF>
+    ContainerT<ContainerT<StateT>> check(
+            ValidationF isGoalState,
+            search_order order,
+            const search_control *control) {
+        ContainerT<ContainerT<StateT>> result;
+        search([&](const trace_state<StateT> &trace) {
+            if (!isGoalState(trace.self)) {
+                return false;
+            }
+            // Requirement 3: the solution holds a state sequence from initial to a goal state.
+            result.push_back(makeSolution(&trace));
+            return _solutionLimit != 0 && result.size() >= _solutionLimit;
+        }, order, control);
+        return result;
+    }
+
+    // Checks several goals in one exploration, every state is tested against all of them. Returns the traces of each
+    // goal in the order of the goals. The search stops once every goal has tracesPerGoal traces, 0 searches the whole
+    // state space. limit_solutions does not apply here.
+    ContainerT<ContainerT<ContainerT<StateT>>> check_many(
+            const std::vector<std::function<bool(const StateT &)>> &goals,
+            size_t tracesPerGoal = 1,
+            search_order order = search_order::breadth_first,
+            const search_control *control = nullptr) {
+        std::vector<ContainerT<ContainerT<StateT>>> results(goals.size());
+        auto unsatisfied = goals.size();
+        search([&](const trace_state<StateT> &trace) {
+            for (size_t g = 0; g < goals.size(); ++g) {
+                if ((tracesPerGoal == 0 || results[g].size() < tracesPerGoal) && goals[g](trace.self)) {
+                    results[g].push_back(makeSolution(&trace));
+                    if (results[g].size() == tracesPerGoal) {
+                        --unsatisfied;
+                    }
+                }
+            }
+            return tracesPerGoal != 0 && unsatisfied == 0;
+        }, order, control);
+        ContainerT<ContainerT<ContainerT<StateT>>> result;
+        for (auto &traces: results) {
+            result.push_back(std::move(traces));
         }
-        return solver(isGoalState, order);
+        return result;
+    }
+
+    // Runs the check on its own thread. The state space must outlive the future and must not be checked by anyone
+    // else until the future is ready, as the search uses its store and resource.
+    template<class ValidationF>
+    std::future<ContainerT<ContainerT<StateT>>> check_async(
+            ValidationF isGoalState,
+            search_order order = search_order::breadth_first,
+            search_control control = {}) {
+        return std::async(std::launch::async, [this, isGoalState, order, control = std::move(control)]() {
+            return check(isGoalState, order, &control);
+        });
     }
 };
 
 // The default solver when cost is not involved
 template<class StateT, template<class...> class ContainerT, class CostT>
-template<class ValidationF>
-ContainerT<ContainerT<StateT>>
-state_space_t<StateT, ContainerT, CostT>::solver(ValidationF isGoalState, search_order order) {
-    StateT currentState;
+template<class ReachedF>
+void state_space_t<StateT, ContainerT, CostT>::solver(ReachedF reached, search_order order,
+                                                      const search_control *control) {
+    StateT currentState = copyState(_initialState);
+    size_t expanded = 0;
     std::shared_ptr<trace_state<StateT>> traceState{};
-    std::list<StateT> passed;
-    std::list<std::shared_ptr<trace_state<StateT>>> waiting;
-    std::list<StateT> traces;
-
-    // Two containers are used, one to hold a result in the given container type and another to
-    // hold all solutions (result)
-    ContainerT<StateT> containedSolution;
-    ContainerT<ContainerT<StateT>> result;
+    auto passed = passedStore();
+    bool recording = _record != nullptr;
+    std::pmr::list<std::shared_ptr<trace_state<StateT>>> waiting{_resource};
 
     // Add the initial to waiting list to have a starting point
     // Set parent as nullptr to know when to stop
-    waiting.push_back(std::make_shared<trace_state<StateT>>(trace_state<StateT>{nullptr, _initialState}));
+    waiting.push_back(makeTrace(nullptr, copyState(_initialState)));
+    if (_duplicates == duplicate_detection::on_generation) {
+        passed->insert(_initialState);
+    }
 
     // Keep iterating through the waiting list until it is empty
     while (!waiting.empty()) {
+        PROFILE_ITERATION();
+        if (cancelled(control)) {
+            break;
+        }
         // Requirement 4: Support various search orders (BFS, DFS)
-        if (order == search_order::breadth_first) {
-            currentState = waiting.front()->self;
-            traceState = waiting.front();
-            waiting.pop_front();
-        } else if (order == search_order::depth_first) {
-            currentState = waiting.back()->self;
-            traceState = waiting.back();
-            waiting.pop_back();
-        } else {
-            std::cout << "Invalid search order supplied.";
+        {
+            PROFILE_PHASE(pop);
+            if (order == search_order::breadth_first) {
+                currentState = waiting.front()->self;
+                traceState = waiting.front();
+                waiting.pop_front();
+            } else if (order == search_order::depth_first) {
+                currentState = waiting.back()->self;
+                traceState = waiting.back();
+                waiting.pop_back();
+            } else {
+                std::cout << "Invalid search order supplied.";
+            }
         }
 
         // Requirement 2: Find a state satisfying the goal predicate
-        if (isGoalState(currentState)) {
-            while (traceState->parent != nullptr) {
-                // Add stack trace to the solution list
-                traces.push_front(traceState->self);
-                traceState = traceState->parent;
-            }
-
-            // Add self trace to solution list
-            traces.push_front(traceState->self);
-
-            // Convert to a generic type by pushing them all to the contained solution.
-            for (auto &trace: traces) {
-                containedSolution.push_back(trace);
-            }
-
-            // Requirement 3: containedSolution now holds a state sequence from initial to a goal state.
-            // Add found result to list of result traces.
-            result.push_back(containedSolution);
+        bool done;
+        {
+            PROFILE_PHASE(goal);
+            done = reached(*traceState);
+        }
+        if (done) {
+            break;
         }
 
         // Check if the element already exists between in the passed states list to ensure that
         // you don't re-visit it.
-        if (!(find(passed.begin(), passed.end(), currentState) != passed.end())) {
-            passed.push_back(currentState);
-            auto transitions = _transitionFunction(currentState);
+        bool unvisited = true;
+        if (_duplicates == duplicate_detection::on_expansion) {
+            PROFILE_PHASE(dedup);
+            unvisited = passed->insert(currentState);
+        }
+        if (unvisited) {
+            recordState(currentState, recording);
+            if (poll(control, ++expanded, waiting.size(), traceState)) {
+                break;
+            }
+            ContainerT<std::function<void(StateT &)>> transitions;
+            {
+                PROFILE_PHASE(transitions);
+                transitions = _transitionFunction(currentState);
+            }
 
             for (auto transition: transitions) {
-                auto successor{currentState};
-                transition(successor);
+                auto successor = copyState(currentState);
+                {
+                    PROFILE_PHASE(successor);
+                    transition(successor);
+                }
+
+                // Skip successors that were seen before, whether they are passed or still waiting
+                if (_duplicates == duplicate_detection::on_generation) {
+                    PROFILE_PHASE(dedup);
+                    if (!passed->insert(successor)) {
+                        continue;
+                    }
+                }
 
                 // Requirement 5: Support a given invariant predicate.
-                if (_invariantFunction(successor)) {
-                    waiting.push_back(std::make_shared<trace_state<StateT>>(trace_state<StateT>{traceState, successor}));
+                bool valid;
+                {
+                    PROFILE_PHASE(invariant);
+                    valid = _invariantFunction(successor);
+                }
+                if (valid) {
+                    PROFILE_PHASE(push);
+                    waiting.push_back(makeTrace(traceState, std::move(successor)));
                 }
             }
         }
     }
-    return result;
 }
 
 // Requirement 6: Support a custom cost function over states.
 // This cost solver uses the cost rather than DFS or BFS for traversing the waiting list.
 template<class StateT, template<class...> class ContainerT, class CostT>
-template<class ValidationF>
-ContainerT<ContainerT<StateT>>
-state_space_t<StateT, ContainerT, CostT>::costSolver(ValidationF isGoalState) {
-    StateT currentState;
+template<class ReachedF, class WaitingT>
+void state_space_t<StateT, ContainerT, CostT>::costSolver(ReachedF reached, const search_control *control,
+                                                          WaitingT &waiting) {
+    StateT currentState = copyState(_initialState);
+    size_t expanded = 0;
     CostT currentCost, newCost;
     currentCost = _initialCost;
     std::shared_ptr<trace_state<StateT>> traceState;
-    std::list<StateT> passed, solution;
-    std::priority_queue<std::pair<CostT, std::shared_ptr<trace_state<StateT>>>> waiting;
-    ContainerT<StateT> containedSolution;
-    ContainerT<ContainerT<StateT>> result;
+    auto passed = passedStore();
+    bool recording = _record != nullptr;
+    using waiting_t = cost_entry<StateT, CostT>;
+    // The priority of a state in the waiting queue, its cost unless a heuristic is used
+    auto priority = [this](const StateT &state, const CostT &cost) {
+        return _heuristicFunction ? _heuristicFunction(state, cost) : cost;
+    };
 
     // Generate a set of cost and trace state to find the lowest cost aka where to go next
-    waiting.push(std::make_pair(currentCost, std::make_shared<trace_state<StateT>>(trace_state<StateT>{nullptr, _initialState})));
+    waiting.push(waiting_t{priority(_initialState, currentCost), currentCost,
+                           makeTrace(nullptr, copyState(_initialState))});
 
     while (!waiting.empty()) {
+        PROFILE_ITERATION();
+        if (cancelled(control)) {
+            break;
+        }
         // Prepare to go to the next state, which is next in the queue
-        currentState = waiting.top().second->self;
-        currentCost = waiting.top().first; // First element of pair is cost
-        traceState = waiting.top().second; // Second element is trace state
-        waiting.pop();
-
-        if (isGoalState(currentState)) {
-            while (traceState->parent != nullptr) {
-                // Add stack trace to the solution list
-                solution.push_front(traceState->self);
-                traceState = traceState->parent;
-            }
-
-            // Add self trace to solution list
-            solution.push_front(traceState->self);
-
-
-            // Convert to a container
-            for (StateT &st: solution) {
-                containedSolution.push_back(st);
-            }
+        {
+            PROFILE_PHASE(pop);
+            currentState = waiting.top().trace->self;
+            currentCost = waiting.top().cost;
+            traceState = waiting.top().trace;
+            waiting.pop();
+        }
 
-            result.push_back(containedSolution);
+        bool done;
+        {
+            PROFILE_PHASE(goal);
+            done = reached(*traceState);
+        }
+        if (done) {
+            break;
         }
 
         // Check if current state has already been passed otherwise push it
-        if (!(find(passed.begin(), passed.end(), currentState) != passed.end())) {
-            passed.push_back(currentState);
-            auto transitions = _transitionFunction(currentState);
+        bool unvisited;
+        {
+            PROFILE_PHASE(dedup);
+            unvisited = passed->insert(currentState);
+        }
+        if (unvisited) {
+            recordState(currentState, recording);
+            if (poll(control, ++expanded, waiting.size(), traceState)) {
+                break;
+            }
+            ContainerT<std::function<void(StateT &)>> transitions;
+            {
+                PROFILE_PHASE(transitions);
+                transitions = _transitionFunction(currentState);
+            }
 
             for (auto transition: transitions) {
-                auto successor{currentState};
-                transition(successor);
+                auto successor = copyState(currentState);
+                {
+                    PROFILE_PHASE(successor);
+                    transition(successor);
+                }
 
-                if (!_invariantFunction(successor)) {
+                // Skip successors that were expanded already, their cost can not be lower now
+                if (_duplicates == duplicate_detection::on_generation) {
+                    PROFILE_PHASE(dedup);
+                    if (passed->contains(successor)) {
+                        continue;
+                    }
+                }
+
+                bool valid;
+                {
+                    PROFILE_PHASE(invariant);
+                    valid = _invariantFunction(successor);
+                }
+                if (!valid) {
                     continue;
                 }
-                newCost = _costFunction(successor, currentCost);
-                waiting.push(std::make_pair(newCost, std::make_shared<trace_state<StateT>>(trace_state<StateT>{traceState, successor})));
+                {
+                    PROFILE_PHASE(cost);
+                    newCost = _costFunction(successor, currentCost);
+                }
+                PROFILE_PHASE(push);
+                auto successorPriority = priority(successor, newCost);
+                waiting.push(waiting_t{successorPriority, newCost, makeTrace(traceState, std::move(successor))});
             }
         }
     }
-
-    return result;
 }
 
 #endif //PUZZLEENGINE_REACHABILITY_HPP